@@ -0,0 +1,520 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Microbenchmark for the evdev decoder.
+ *
+ * Usage: twofingbench [-n iterations] [recording ...]
+ *
+ * A recording is a raw dump of struct input_event records, e.g. taken with
+ * "cat /dev/input/eventN > recording". Without recordings, synthetic two-finger
+ * streams at 200 Hz are used for both multi-touch protocols.
+ *
+ * The decoder is compared against a comparison chain doing the same work, which shows
+ * what the handler tables gain, and against the old decoder, which does less. */
+
+#include <linux/input.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "decoder.h"
+
+#define SYNTHETIC_FRAMES 2000
+
+typedef struct Recording Recording;
+
+struct Recording {
+	const char* name;
+	struct input_event* events;
+	int count;
+};
+
+/* Prevents the compiler from optimizing the decoding away */
+volatile long frameSink;
+
+
+/* The decoder as it was before it got its handler tables: a chain of code comparisons
+ * that every event runs through, with two slots and no event type check. Kept to show
+ * where the decoder came from, not as a fair baseline. */
+
+typedef struct ReferenceDecoder ReferenceDecoder;
+
+struct ReferenceDecoder {
+	FingerInfo fingerInfos[2];
+	FingerInfo tempFingerInfo;
+	int currentSlot;
+	int useLegacyProtocol;
+};
+
+static void initReferenceDecoder(ReferenceDecoder* ref) {
+	memset(ref, 0, sizeof(ReferenceDecoder));
+	ref->fingerInfos[0].id = -1;
+	ref->fingerInfos[1].id = -1;
+	ref->tempFingerInfo.id = -1;
+}
+
+static int referenceDecodeEvent(ReferenceDecoder* ref, const struct input_event* ev) {
+	FingerInfo* fingerInfos = ref->fingerInfos;
+	int i;
+
+	if (ev->type == EV_SYN) {
+		if (0 == ev->code) {
+			if (ref->useLegacyProtocol) {
+				for (i = 0; i < 2; i++) {
+					if (fingerInfos[i].setThisTime) {
+						fingerInfos[i].setThisTime = 0;
+					} else {
+						fingerInfos[i].slotUsed = 0;
+					}
+				}
+				ref->tempFingerInfo.slotUsed = 0;
+			}
+			return DECODE_FRAME;
+		} else if (2 == ev->code) {
+			if (!ref->useLegacyProtocol) {
+				ref->useLegacyProtocol = 1;
+				ref->currentSlot = -1;
+				ref->tempFingerInfo.slotUsed = 0;
+			} else if (ref->tempFingerInfo.slotUsed) {
+				int index = -1;
+				for (i = 0; i < 2; i++) {
+					if (fingerInfos[i].slotUsed && fingerInfos[i].id == ref->tempFingerInfo.id) {
+						index = i;
+						break;
+					}
+				}
+				if (index == -1) {
+					for (i = 0; i < 2; i++) {
+						if (!fingerInfos[i].slotUsed) {
+							index = i;
+							fingerInfos[i].id = ref->tempFingerInfo.id;
+							fingerInfos[i].slotUsed = 1;
+							break;
+						}
+					}
+				}
+				if (index != -1) {
+					fingerInfos[index].setThisTime = 1;
+					fingerInfos[index].rawX = ref->tempFingerInfo.rawX;
+					fingerInfos[index].rawY = ref->tempFingerInfo.rawY;
+					fingerInfos[index].rawZ = ref->tempFingerInfo.rawZ;
+				}
+			}
+		}
+	} else if (ev->type == EV_MSC && (ev->code == MSC_RAW || ev->code == MSC_SCAN)) {
+	} else if (ev->code == 47) {
+		ref->currentSlot = ev->value;
+		if (ref->currentSlot < 0 || ref->currentSlot > 1) ref->currentSlot = -1;
+	} else {
+		if (ev->code == 57) {
+			if (ref->currentSlot != -1) {
+				if (ev->value == -1) {
+					fingerInfos[ref->currentSlot].slotUsed = 0;
+				} else {
+					fingerInfos[ref->currentSlot].id = ev->value;
+					fingerInfos[ref->currentSlot].slotUsed = 1;
+				}
+			} else if (ref->useLegacyProtocol) {
+				ref->tempFingerInfo.id = ev->value;
+				ref->tempFingerInfo.slotUsed = 1;
+			}
+		}
+		if (ev->code == 53) {
+			if (ref->currentSlot != -1) {
+				fingerInfos[ref->currentSlot].rawX = ev->value;
+			} else if (ref->useLegacyProtocol) {
+				ref->tempFingerInfo.rawX = ev->value;
+			}
+		}
+		if (ev->code == 54) {
+			if (ref->currentSlot != -1) {
+				fingerInfos[ref->currentSlot].rawY = ev->value;
+			} else if (ref->useLegacyProtocol) {
+				ref->tempFingerInfo.rawY = ev->value;
+			}
+		}
+		if (ev->code == 58) {
+			if (ref->currentSlot != -1) {
+				fingerInfos[ref->currentSlot].rawZ = ev->value;
+			} else if (ref->useLegacyProtocol) {
+				ref->tempFingerInfo.rawZ = ev->value;
+			}
+		}
+	}
+	return DECODE_CONTINUE;
+}
+
+
+/* The same decoder with a chain of comparisons instead of the handler tables: it checks the
+ * event type, tracks the same number of slots and keeps the same dense contact table, so the
+ * only difference to decodeEvents is how an event finds its handler. This is the baseline
+ * that tells whether the tables pay off. */
+
+typedef struct ChainDecoder ChainDecoder;
+
+struct ChainDecoder {
+	int slotCount;
+	FingerInfo slots[DECODER_MAX_SLOTS];
+	int contactSlots[DECODER_MAX_SLOTS];
+	int slotToContact[DECODER_MAX_SLOTS];
+	int activeCount;
+	FingerInfo contacts[DECODER_MAX_SLOTS];
+	int contactCount;
+	struct timeval frameTime;
+	int currentSlot;
+	FingerInfo tempFingerInfo;
+	int useLegacyProtocol;
+	/* Ignoring everything up to the next SYN_REPORT after SYN_DROPPED */
+	int dropping;
+};
+
+static void initChainDecoder(ChainDecoder* chain) {
+	int i;
+	memset(chain, 0, sizeof(ChainDecoder));
+	chain->slotCount = DECODER_DEFAULT_SLOTS;
+	for (i = 0; i < DECODER_MAX_SLOTS; i++) {
+		chain->slots[i].id = -1;
+		chain->slotToContact[i] = -1;
+	}
+	chain->tempFingerInfo.id = -1;
+}
+
+static void chainAddContact(ChainDecoder* chain, int slot) {
+	chain->slots[slot].slotUsed = 1;
+	chain->contactSlots[chain->activeCount] = slot;
+	chain->slotToContact[slot] = chain->activeCount;
+	chain->activeCount++;
+}
+
+static void chainRemoveContact(ChainDecoder* chain, int slot) {
+	int i;
+	chain->slots[slot].slotUsed = 0;
+	for (i = chain->slotToContact[slot] + 1; i < chain->activeCount; i++) {
+		chain->contactSlots[i - 1] = chain->contactSlots[i];
+		chain->slotToContact[chain->contactSlots[i]] = i - 1;
+	}
+	chain->slotToContact[slot] = -1;
+	chain->activeCount--;
+}
+
+/* Finger that receives ABS_MT_* values, NULL if they are ignored */
+static FingerInfo* chainTarget(ChainDecoder* chain) {
+	if (chain->currentSlot != -1)
+		return &(chain->slots[chain->currentSlot]);
+	if (chain->useLegacyProtocol)
+		return &(chain->tempFingerInfo);
+	return NULL;
+}
+
+/* Legacy protocol: saves the finger collected in tempFingerInfo to its slot. The tracking
+ * id is looked up among the fingers that are on, which is as cheap as the decoder's hash
+ * table for the few fingers of a touchscreen. */
+static void chainCommitLegacyFinger(ChainDecoder* chain) {
+	FingerInfo* temp = &(chain->tempFingerInfo);
+	int slot = -1;
+	int i;
+
+	if (!temp->slotUsed)
+		return;
+	for (i = 0; i < chain->activeCount; i++) {
+		if (chain->slots[chain->contactSlots[i]].id == temp->id) {
+			slot = chain->contactSlots[i];
+			break;
+		}
+	}
+	if (slot == -1) {
+		for (i = 0; i < chain->slotCount; i++) {
+			if (!chain->slots[i].slotUsed) {
+				slot = i;
+				chain->slots[i].id = temp->id;
+				chainAddContact(chain, i);
+				break;
+			}
+		}
+	}
+	if (slot != -1) {
+		chain->slots[slot].setThisTime = 1;
+		chain->slots[slot].rawX = temp->rawX;
+		chain->slots[slot].rawY = temp->rawY;
+		chain->slots[slot].rawZ = temp->rawZ;
+	}
+}
+
+static void chainFinishFrame(ChainDecoder* chain, const struct input_event* ev) {
+	int i;
+	if (chain->useLegacyProtocol) {
+		for (i = chain->activeCount - 1; i >= 0; i--) {
+			FingerInfo* slot = &(chain->slots[chain->contactSlots[i]]);
+			if (slot->setThisTime) {
+				slot->setThisTime = 0;
+			} else {
+				chainRemoveContact(chain, chain->contactSlots[i]);
+			}
+		}
+		chain->tempFingerInfo.slotUsed = 0;
+	}
+	for (i = 0; i < chain->activeCount; i++) {
+		chain->contacts[i] = chain->slots[chain->contactSlots[i]];
+	}
+	chain->contactCount = chain->activeCount;
+	chain->frameTime = ev->time;
+}
+
+/* Same contract as decodeEvents */
+static int chainDecodeEvents(ChainDecoder* chain, const struct input_event* ev, int count, int* consumed) {
+	FingerInfo* target;
+	int i, slot;
+
+	for (i = 0; i < count; i++) {
+		if (ev[i].type == EV_SYN) {
+			if (ev[i].code == SYN_REPORT) {
+				if (chain->dropping) {
+					/* Without a device there is nothing to resync from */
+					chain->dropping = 0;
+					while (chain->activeCount > 0)
+						chainRemoveContact(chain, chain->contactSlots[chain->activeCount - 1]);
+					chain->tempFingerInfo.slotUsed = 0;
+				}
+				chainFinishFrame(chain, &(ev[i]));
+				*consumed = i + 1;
+				return DECODE_FRAME;
+			} else if (chain->dropping) {
+			} else if (ev[i].code == SYN_MT_REPORT) {
+				if (!chain->useLegacyProtocol) {
+					chain->useLegacyProtocol = 1;
+					chain->currentSlot = -1;
+					chain->tempFingerInfo.slotUsed = 0;
+				} else {
+					chainCommitLegacyFinger(chain);
+				}
+			} else if (ev[i].code == SYN_DROPPED) {
+				chain->dropping = 1;
+			}
+		} else if (ev[i].type == EV_ABS && !chain->dropping) {
+			if (ev[i].code == ABS_MT_POSITION_X) {
+				if ((target = chainTarget(chain)) != NULL)
+					target->rawX = ev[i].value;
+			} else if (ev[i].code == ABS_MT_POSITION_Y) {
+				if ((target = chainTarget(chain)) != NULL)
+					target->rawY = ev[i].value;
+			} else if (ev[i].code == ABS_MT_PRESSURE) {
+				if ((target = chainTarget(chain)) != NULL)
+					target->rawZ = ev[i].value;
+			} else if (ev[i].code == ABS_MT_SLOT) {
+				if (!chain->useLegacyProtocol) {
+					chain->currentSlot = ev[i].value;
+					if (chain->currentSlot < 0 || chain->currentSlot >= chain->slotCount)
+						chain->currentSlot = -1;
+				}
+			} else if (ev[i].code == ABS_MT_TRACKING_ID) {
+				if (chain->useLegacyProtocol) {
+					chain->tempFingerInfo.id = ev[i].value;
+					chain->tempFingerInfo.slotUsed = 1;
+				} else if ((slot = chain->currentSlot) != -1) {
+					if (ev[i].value == -1) {
+						if (chain->slots[slot].slotUsed)
+							chainRemoveContact(chain, slot);
+					} else {
+						chain->slots[slot].id = ev[i].value;
+						if (!chain->slots[slot].slotUsed)
+							chainAddContact(chain, slot);
+					}
+				}
+			}
+		}
+	}
+	*consumed = count;
+	return DECODE_CONTINUE;
+}
+
+
+/* Synthetic recordings */
+
+static void addEvent(Recording* rec, long usec, int type, int code, int value) {
+	struct input_event* ev = &(rec->events[rec->count++]);
+	ev->time.tv_sec = usec / 1000000;
+	ev->time.tv_usec = usec % 1000000;
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+/* Two fingers performing a pinch at 200 Hz, reported like a typical slotted panel
+ * (including MSC_TIMESTAMP and the single-touch emulation events). */
+static void synthesizeSlotted(Recording* rec) {
+	int frame, slot;
+	rec->name = "synthetic protocol B, 200 Hz";
+	rec->events = malloc(SYNTHETIC_FRAMES * 20 * sizeof(struct input_event));
+	rec->count = 0;
+	for (frame = 0; frame < SYNTHETIC_FRAMES; frame++) {
+		long usec = frame * 5000L;
+		for (slot = 0; slot < 2; slot++) {
+			addEvent(rec, usec, EV_ABS, ABS_MT_SLOT, slot);
+			if (frame == 0) addEvent(rec, usec, EV_ABS, ABS_MT_TRACKING_ID, 100 + slot);
+			addEvent(rec, usec, EV_ABS, ABS_MT_POSITION_X, 1000 + (slot ? frame : -frame));
+			addEvent(rec, usec, EV_ABS, ABS_MT_POSITION_Y, 2000 + (slot ? frame : -frame));
+			addEvent(rec, usec, EV_ABS, ABS_MT_PRESSURE, 40 + frame % 8);
+		}
+		if (frame == 0) addEvent(rec, usec, EV_KEY, BTN_TOUCH, 1);
+		addEvent(rec, usec, EV_ABS, ABS_X, 1000 - frame);
+		addEvent(rec, usec, EV_ABS, ABS_Y, 2000 - frame);
+		addEvent(rec, usec, EV_MSC, MSC_TIMESTAMP, frame * 5000);
+		addEvent(rec, usec, EV_SYN, SYN_REPORT, 0);
+	}
+}
+
+/* The same gesture reported with the legacy protocol */
+static void synthesizeLegacy(Recording* rec) {
+	int frame, finger;
+	rec->name = "synthetic protocol A, 200 Hz";
+	rec->events = malloc(SYNTHETIC_FRAMES * 16 * sizeof(struct input_event));
+	rec->count = 0;
+	for (frame = 0; frame < SYNTHETIC_FRAMES; frame++) {
+		long usec = frame * 5000L;
+		for (finger = 0; finger < 2; finger++) {
+			addEvent(rec, usec, EV_ABS, ABS_MT_TRACKING_ID, finger);
+			addEvent(rec, usec, EV_ABS, ABS_MT_POSITION_X, 1000 + (finger ? frame : -frame));
+			addEvent(rec, usec, EV_ABS, ABS_MT_POSITION_Y, 2000 + (finger ? frame : -frame));
+			addEvent(rec, usec, EV_ABS, ABS_MT_PRESSURE, 40 + frame % 8);
+			addEvent(rec, usec, EV_SYN, SYN_MT_REPORT, 0);
+		}
+		addEvent(rec, usec, EV_KEY, BTN_TOUCH, 1);
+		addEvent(rec, usec, EV_SYN, SYN_REPORT, 0);
+	}
+}
+
+static int loadRecording(Recording* rec, const char* fileName) {
+	FILE* file = fopen(fileName, "rb");
+	if (file == NULL) {
+		perror(fileName);
+		return 0;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	rec->name = fileName;
+	rec->count = size / sizeof(struct input_event);
+	rec->events = malloc(rec->count * sizeof(struct input_event) + 1);
+	if (rec->events == NULL || fread(rec->events, sizeof(struct input_event), rec->count, file) != rec->count) {
+		fprintf(stderr, "Couldn't read %s\n", fileName);
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	return 1;
+}
+
+
+/* Measurement */
+
+static long nanoseconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void benchRecording(Recording* rec, int iterations) {
+	Decoder decoder;
+	ChainDecoder chain;
+	ReferenceDecoder ref;
+	long frames, start, tableTime, chainTime, referenceTime;
+	int it, i, consumed;
+
+	/* Table-driven decoder */
+	frames = 0;
+	start = nanoseconds();
+	for (it = 0; it < iterations; it++) {
+		if (initDecoder(&decoder, -1) != 0) {
+			fprintf(stderr, "Couldn't allocate decoder\n");
+			exit(1);
+		}
+		for (i = 0; i < rec->count; i += consumed) {
+			if (decodeEvents(&decoder, &(rec->events[i]), rec->count - i, &consumed) == DECODE_FRAME) {
+				frames++;
+				if (decoder.contactCount > 0)
+					frameSink += decoder.contacts[0].rawX;
+			}
+		}
+		freeDecoder(&decoder);
+	}
+	tableTime = nanoseconds() - start;
+
+	/* Comparison chain doing the same work */
+	start = nanoseconds();
+	for (it = 0; it < iterations; it++) {
+		initChainDecoder(&chain);
+		for (i = 0; i < rec->count; i += consumed) {
+			if (chainDecodeEvents(&chain, &(rec->events[i]), rec->count - i, &consumed) == DECODE_FRAME) {
+				if (chain.contactCount > 0)
+					frameSink += chain.contacts[0].rawX;
+			}
+		}
+	}
+	chainTime = nanoseconds() - start;
+
+	/* Old decoder */
+	start = nanoseconds();
+	for (it = 0; it < iterations; it++) {
+		initReferenceDecoder(&ref);
+		for (i = 0; i < rec->count; i++) {
+			if (referenceDecodeEvent(&ref, &(rec->events[i])) == DECODE_FRAME) {
+				frameSink += ref.fingerInfos[0].rawX;
+			}
+		}
+	}
+	referenceTime = nanoseconds() - start;
+
+	long events = (long) rec->count * iterations;
+	printf("%s\n", rec->name);
+	printf("  %i events, %li frames per pass, %i passes\n", rec->count, frames / iterations, iterations);
+	printf("  decoder:   %7.2f ns/event\n", (double) tableTime / events);
+	printf("  chain:     %7.2f ns/event (%+.0f%% for the decoder)\n", (double) chainTime / events,
+			100.0 * (tableTime - chainTime) / chainTime);
+	printf("  old chain: %7.2f ns/event (2 slots, no type check)\n", (double) referenceTime / events);
+}
+
+int main(int argc, char **argv) {
+	int iterations = 1000;
+	int recordingsGiven = 0;
+	Recording rec;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			if (iterations < 1) iterations = 1;
+		} else {
+			recordingsGiven = 1;
+			if (loadRecording(&rec, argv[i])) {
+				benchRecording(&rec, iterations);
+				free(rec.events);
+			}
+		}
+	}
+
+	if (!recordingsGiven) {
+		synthesizeSlotted(&rec);
+		benchRecording(&rec, iterations);
+		free(rec.events);
+
+		synthesizeLegacy(&rec);
+		benchRecording(&rec, iterations);
+		free(rec.events);
+	}
+
+	return 0;
+}
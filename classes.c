@@ -0,0 +1,243 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <X11/Xlib.h>
+#include "twofingemu.h"
+#include "classes.h"
+
+#define INITIAL_BUCKET_COUNT 64
+
+/* Interned classes: names by id, and a hash table from name to id */
+static ClassInfo* classInfos;
+static int classCount;
+static int classCapacity;
+static int* classBuckets;
+static int* classNext;
+static int classBucketCount;
+
+/* FNV-1a over the significant part of the name */
+static unsigned int hashClassName(const char* name) {
+	unsigned int hash = 2166136261u;
+	int i;
+	for (i = 0; i < CLASS_NAME_SIGNIFICANT && name[i] != '\0'; i++) {
+		hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static int classNamesEqual(const char* a, const char* b) {
+	return strncmp(a, b, CLASS_NAME_SIGNIFICANT) == 0;
+}
+
+static void rehashClasses(int bucketCount) {
+	int* buckets = malloc(bucketCount * sizeof(int));
+	int i;
+	if (buckets == NULL)
+		return;
+	free(classBuckets);
+	classBuckets = buckets;
+	classBucketCount = bucketCount;
+	for (i = 0; i < bucketCount; i++) {
+		classBuckets[i] = CLASS_NONE;
+	}
+	for (i = 0; i < classCount; i++) {
+		unsigned int bucket = hashClassName(classInfos[i].name) & (bucketCount - 1);
+		classNext[i] = classBuckets[bucket];
+		classBuckets[bucket] = i;
+	}
+}
+
+/* Returns the id of the given class name, CLASS_NONE for NULL (or if out of memory) */
+int internClass(const char* name) {
+	int id;
+	if (name == NULL)
+		return CLASS_NONE;
+
+	if (classBuckets != NULL) {
+		for (id = classBuckets[hashClassName(name) & (classBucketCount - 1)]; id != CLASS_NONE; id = classNext[id]) {
+			if (classNamesEqual(classInfos[id].name, name))
+				return id;
+		}
+	}
+
+	if (classCount == classCapacity) {
+		int capacity = classCapacity == 0 ? INITIAL_BUCKET_COUNT : classCapacity * 2;
+		ClassInfo* infos = realloc(classInfos, capacity * sizeof(ClassInfo));
+		if (infos == NULL)
+			return CLASS_NONE;
+		classInfos = infos;
+		int* next = realloc(classNext, capacity * sizeof(int));
+		if (next == NULL)
+			return CLASS_NONE;
+		classNext = next;
+		classCapacity = capacity;
+	}
+
+	char* copy = strdup(name);
+	if (copy == NULL)
+		return CLASS_NONE;
+	id = classCount++;
+	memset(&(classInfos[id]), 0, sizeof(ClassInfo));
+	classInfos[id].name = copy;
+
+	if (classCount > classBucketCount) {
+		rehashClasses(classBucketCount == 0 ? INITIAL_BUCKET_COUNT : classBucketCount * 2);
+	} else {
+		unsigned int bucket = hashClassName(name) & (classBucketCount - 1);
+		classNext[id] = classBuckets[bucket];
+		classBuckets[bucket] = id;
+	}
+	return id;
+}
+
+/* Returns the name of the class with the given id, NULL for CLASS_NONE */
+const char* getClassName(int id) {
+	return id >= 0 && id < classCount ? classInfos[id].name : NULL;
+}
+
+/* Returns what is known about the class with the given id, NULL for CLASS_NONE */
+ClassInfo* getClassInfo(int id) {
+	return id >= 0 && id < classCount ? &(classInfos[id]) : NULL;
+}
+
+/* Forgets the memoized results, e.g. because the profiles have changed */
+void invalidateClassInfos() {
+	int i;
+	for (i = 0; i < classCount; i++) {
+		classInfos[i].resolved = 0;
+	}
+}
+
+
+/* Class maps */
+
+static int isPattern(const char* pattern) {
+	return strpbrk(pattern, "*?[") != NULL;
+}
+
+void initClassMap(ClassMap* map) {
+	memset(map, 0, sizeof(ClassMap));
+}
+
+void freeClassMap(ClassMap* map) {
+	int i;
+	ClassMapEntry* entry;
+	for (i = 0; i < map->bucketCount; i++) {
+		while ((entry = map->buckets[i]) != NULL) {
+			map->buckets[i] = entry->next;
+			free(entry->pattern);
+			free(entry);
+		}
+	}
+	while ((entry = map->patterns) != NULL) {
+		map->patterns = entry->next;
+		free(entry->pattern);
+		free(entry);
+	}
+	free(map->buckets);
+	initClassMap(map);
+}
+
+static void growClassMap(ClassMap* map) {
+	int bucketCount = map->bucketCount == 0 ? INITIAL_BUCKET_COUNT : map->bucketCount * 2;
+	ClassMapEntry** buckets = calloc(bucketCount, sizeof(ClassMapEntry*));
+	int i;
+	if (buckets == NULL)
+		return;
+	for (i = 0; i < map->bucketCount; i++) {
+		ClassMapEntry* entry = map->buckets[i];
+		while (entry != NULL) {
+			ClassMapEntry* next = entry->next;
+			unsigned int bucket = hashClassName(entry->pattern) & (bucketCount - 1);
+			entry->next = buckets[bucket];
+			buckets[bucket] = entry;
+			entry = next;
+		}
+	}
+	free(map->buckets);
+	map->buckets = buckets;
+	map->bucketCount = bucketCount;
+}
+
+/* Maps the given class name, or glob pattern (fnmatch syntax), to value. Exact names take
+ * precedence over patterns, patterns are tried in the order they were added.
+ * Returns 0 on success. */
+int addClassMapping(ClassMap* map, const char* pattern, void* value) {
+	ClassMapEntry* entry = malloc(sizeof(ClassMapEntry));
+	if (entry == NULL)
+		return -1;
+	entry->pattern = strdup(pattern);
+	entry->value = value;
+	entry->next = NULL;
+	if (entry->pattern == NULL) {
+		free(entry);
+		return -1;
+	}
+
+	if (isPattern(pattern)) {
+		if (map->lastPattern != NULL) map->lastPattern->next = entry;
+		else map->patterns = entry;
+		map->lastPattern = entry;
+		return 0;
+	}
+
+	/* The first mapping of a name wins */
+	if (map->bucketCount > 0) {
+		ClassMapEntry* existing;
+		for (existing = map->buckets[hashClassName(pattern) & (map->bucketCount - 1)]; existing != NULL; existing = existing->next) {
+			if (classNamesEqual(existing->pattern, pattern)) {
+				free(entry->pattern);
+				free(entry);
+				return 0;
+			}
+		}
+	}
+
+	if (map->entryCount >= map->bucketCount)
+		growClassMap(map);
+	if (map->buckets == NULL) {
+		free(entry->pattern);
+		free(entry);
+		return -1;
+	}
+	unsigned int bucket = hashClassName(pattern) & (map->bucketCount - 1);
+	entry->next = map->buckets[bucket];
+	map->buckets[bucket] = entry;
+	map->entryCount++;
+	return 0;
+}
+
+/* Returns the value the given class name maps to: that of the exact name if there is
+ * one, otherwise that of the first matching pattern. NULL if there is none. */
+void* lookupClassMap(ClassMap* map, const char* name) {
+	ClassMapEntry* entry;
+	if (name == NULL)
+		return NULL;
+	if (map->bucketCount > 0) {
+		for (entry = map->buckets[hashClassName(name) & (map->bucketCount - 1)]; entry != NULL; entry = entry->next) {
+			if (classNamesEqual(entry->pattern, name))
+				return entry->value;
+		}
+	}
+	for (entry = map->patterns; entry != NULL; entry = entry->next) {
+		if (fnmatch(entry->pattern, name, 0) == 0)
+			return entry->value;
+	}
+	return NULL;
+}
@@ -0,0 +1,69 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CLASSES_H_
+#define CLASSES_H_
+
+/* Window classes are interned to small integer ids, so that what we know about a
+ * class (its profile, whether it is blacklisted) is looked up only once per class. */
+
+/* Id of windows without a class */
+#define CLASS_NONE -1
+
+/* Number of characters of a class name that are compared */
+#define CLASS_NAME_SIGNIFICANT 30
+
+typedef struct ClassInfo ClassInfo;
+typedef struct ClassMap ClassMap;
+typedef struct ClassMapEntry ClassMapEntry;
+
+struct ClassInfo {
+	char* name;
+	/* Memoized by the gesture code; only valid if resolved */
+	int resolved;
+	Profile* profile;
+	int blacklisted;
+	/* Is it a window manager (whose frames have to be looked into)? */
+	int windowManager;
+};
+
+/* Maps class names, or glob patterns of them, to values */
+struct ClassMap {
+	ClassMapEntry** buckets;
+	int bucketCount;
+	int entryCount;
+	/* Entries with glob patterns, in the order they were added */
+	ClassMapEntry* patterns;
+	ClassMapEntry* lastPattern;
+};
+
+struct ClassMapEntry {
+	char* pattern;
+	void* value;
+	ClassMapEntry* next;
+};
+
+int internClass(const char* name);
+const char* getClassName(int id);
+ClassInfo* getClassInfo(int id);
+void invalidateClassInfos();
+
+void initClassMap(ClassMap* map);
+void freeClassMap(ClassMap* map);
+int addClassMapping(ClassMap* map, const char* pattern, void* value);
+void* lookupClassMap(ClassMap* map, const char* name);
+
+#endif /* CLASSES_H_ */
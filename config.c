@@ -0,0 +1,640 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Configuration file with the profiles and blacklists.
+ *
+ * The file consists of sections. [blacklist] and [wm-blacklist] list one window class
+ * per line. [default] changes settings of the default profile, [profile CLASS] defines
+ * the profile of the windows of the given class, with settings like
+ *
+ *   scroll.vstep = 100
+ *   scroll.up = button 5 shift
+ *   zoom.in = key equal ctrl
+ *
+ * A profile uses the scroll, zoom, rotate, swipe and tap settings of the default profile
+ * unless it sets at least one setting of the group; unset settings of a group that is
+ * set are zero, like in profiles.h. Lines starting with # are comments.
+ *
+ * Parsing results are kept in a binary cache file, which is mapped instead of parsing
+ * the file again as long as the file doesn't change. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <X11/Xlib.h>
+#include "twofingemu.h"
+#include "classes.h"
+#include "config.h"
+#include "gestures.h"
+
+#define CONFIG_FILE_NAME "twofing/profiles.conf"
+#define SYSTEM_CONFIG_FILE "/etc/twofing/profiles.conf"
+#define CACHE_DIR_NAME "twofing"
+#define CACHE_FILE_NAME "profiles.cache"
+
+#define MAX_CONFIG_LINE 1024
+
+#define SETTING_INT 0
+#define SETTING_DOUBLE 1
+#define SETTING_BOOL 2
+#define SETTING_ACTION 3
+
+typedef struct Setting Setting;
+typedef struct ParsedConfig ParsedConfig;
+
+/* A profile setting: its name in the file, type and place in Profile, the inherit flag
+ * of its group and, for numbers, the range of values the gesture code can handle */
+struct Setting {
+	const char* name;
+	int type;
+	size_t offset;
+	size_t inheritOffset;
+	double minimum, maximum;
+	/* Are minimum and maximum themselves out of range? */
+	int exclusive;
+};
+
+#define PROFILE_SETTING(name, type, field, group) { name, type, offsetof(Profile, field), offsetof(Profile, group), -HUGE_VAL, HUGE_VAL, 0 }
+#define BOUNDED_SETTING(name, type, field, group, minimum, maximum, exclusive) \
+	{ name, type, offsetof(Profile, field), offsetof(Profile, group), minimum, maximum, exclusive }
+
+static const Setting settings[] = {
+	BOUNDED_SETTING("scroll.min-distance", SETTING_INT, scrollMinDistance, scrollInherit, 0, INT_MAX, 0),
+	BOUNDED_SETTING("scroll.hstep", SETTING_INT, hscrollStep, scrollInherit, 0, INT_MAX, 1),
+	BOUNDED_SETTING("scroll.vstep", SETTING_INT, vscrollStep, scrollInherit, 0, INT_MAX, 1),
+	PROFILE_SETTING("scroll.easing", SETTING_BOOL, scrollEasing, scrollInherit),
+	BOUNDED_SETTING("scroll.easing-decay", SETTING_INT, scrollEasingDecay, scrollInherit, 0, INT_MAX, 0),
+	PROFILE_SETTING("scroll.brace", SETTING_ACTION, scrollBraceAction, scrollInherit),
+	PROFILE_SETTING("scroll.up", SETTING_ACTION, scrollUpAction, scrollInherit),
+	PROFILE_SETTING("scroll.down", SETTING_ACTION, scrollDownAction, scrollInherit),
+	PROFILE_SETTING("scroll.left", SETTING_ACTION, scrollLeftAction, scrollInherit),
+	PROFILE_SETTING("scroll.right", SETTING_ACTION, scrollRightAction, scrollInherit),
+	BOUNDED_SETTING("zoom.min-distance", SETTING_INT, zoomMinDistance, zoomInherit, 0, INT_MAX, 0),
+	BOUNDED_SETTING("zoom.step", SETTING_DOUBLE, zoomStep, zoomInherit, 1, HUGE_VAL, 1),
+	BOUNDED_SETTING("zoom.min-factor", SETTING_DOUBLE, zoomMinFactor, zoomInherit, 1, HUGE_VAL, 0),
+	PROFILE_SETTING("zoom.in", SETTING_ACTION, zoomInAction, zoomInherit),
+	PROFILE_SETTING("zoom.out", SETTING_ACTION, zoomOutAction, zoomInherit),
+	BOUNDED_SETTING("rotate.min-distance", SETTING_INT, rotateMinDistance, rotateInherit, 0, INT_MAX, 0),
+	PROFILE_SETTING("rotate.min-angle", SETTING_DOUBLE, rotateMinAngle, rotateInherit),
+	BOUNDED_SETTING("rotate.step", SETTING_DOUBLE, rotateStep, rotateInherit, 0, 180, 1),
+	PROFILE_SETTING("rotate.left", SETTING_ACTION, rotateLeftAction, rotateInherit),
+	PROFILE_SETTING("rotate.right", SETTING_ACTION, rotateRightAction, rotateInherit),
+	BOUNDED_SETTING("swipe.min-distance", SETTING_INT, swipeMinDistance, swipeInherit, 0, INT_MAX, 0),
+	PROFILE_SETTING("swipe3.up", SETTING_ACTION, swipe3UpAction, swipeInherit),
+	PROFILE_SETTING("swipe3.down", SETTING_ACTION, swipe3DownAction, swipeInherit),
+	PROFILE_SETTING("swipe3.left", SETTING_ACTION, swipe3LeftAction, swipeInherit),
+	PROFILE_SETTING("swipe3.right", SETTING_ACTION, swipe3RightAction, swipeInherit),
+	PROFILE_SETTING("swipe4.up", SETTING_ACTION, swipe4UpAction, swipeInherit),
+	PROFILE_SETTING("swipe4.down", SETTING_ACTION, swipe4DownAction, swipeInherit),
+	PROFILE_SETTING("swipe4.left", SETTING_ACTION, swipe4LeftAction, swipeInherit),
+	PROFILE_SETTING("swipe4.right", SETTING_ACTION, swipe4RightAction, swipeInherit),
+	PROFILE_SETTING("tap", SETTING_ACTION, tapAction, tapInherit),
+	{ NULL, 0, 0, 0, 0, 0, 0 }
+};
+
+/* Offsets of the inherit flags of all groups */
+static const size_t inheritOffsets[] = {
+	offsetof(Profile, scrollInherit), offsetof(Profile, zoomInherit), offsetof(Profile, rotateInherit),
+	offsetof(Profile, swipeInherit), offsetof(Profile, tapInherit)
+};
+
+/* The contents of a configuration file or cache. Strings are referred to by their
+ * offset in strings. */
+struct ParsedConfig {
+	Profile defaultProfile;
+	Profile* profiles;
+	uint32_t* profileClasses;
+	uint32_t profileCount;
+	uint32_t* blacklist;
+	uint32_t blacklistCount;
+	uint32_t* wmBlacklist;
+	uint32_t wmBlacklistCount;
+	char* strings;
+	uint32_t stringsSize;
+	uint32_t stringsCapacity;
+};
+
+
+/* Parsing */
+
+static char* trim(char* s) {
+	char* end;
+	while (isspace((unsigned char) *s)) s++;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char) end[-1])) end--;
+	*end = '\0';
+	return s;
+}
+
+/* Adds a string to the strings of the configuration. Returns its offset, or -1 if out of memory. */
+static long addString(ParsedConfig* config, const char* s) {
+	uint32_t length = strlen(s) + 1;
+	if (config->stringsSize + length > config->stringsCapacity) {
+		uint32_t capacity = config->stringsCapacity == 0 ? 1024 : config->stringsCapacity * 2;
+		while (capacity < config->stringsSize + length) capacity *= 2;
+		char* strings = realloc(config->strings, capacity);
+		if (strings == NULL)
+			return -1;
+		config->strings = strings;
+		config->stringsCapacity = capacity;
+	}
+	memcpy(config->strings + config->stringsSize, s, length);
+	config->stringsSize += length;
+	return config->stringsSize - length;
+}
+
+/* Appends a string offset to a list. Returns 0 on success. */
+static int appendOffset(uint32_t** list, uint32_t* count, long offset) {
+	uint32_t* newList;
+	if (offset < 0 || (newList = realloc(*list, (*count + 1) * sizeof(uint32_t))) == NULL)
+		return -1;
+	*list = newList;
+	(*list)[(*count)++] = offset;
+	return 0;
+}
+
+static void freeParsedConfig(ParsedConfig* config) {
+	free(config->profiles);
+	free(config->profileClasses);
+	free(config->blacklist);
+	free(config->wmBlacklist);
+	free(config->strings);
+}
+
+/* Parses an action: none | button NUMBER [MODIFIER...] | key KEYSYM [MODIFIER...].
+ * Returns 0 on success. */
+static int parseAction(char* value, Action* action) {
+	char* savePtr;
+	char* word = strtok_r(value, " \t", &savePtr);
+	memset(action, 0, sizeof(Action));
+	if (word == NULL)
+		return -1;
+	if (strcmp(word, "none") == 0) {
+		return strtok_r(NULL, " \t", &savePtr) == NULL ? 0 : -1;
+	}
+
+	char* argument = strtok_r(NULL, " \t", &savePtr);
+	if (argument == NULL)
+		return -1;
+	if (strcmp(word, "button") == 0) {
+		char* end;
+		action->actionType = ACTIONTYPE_BUTTONPRESS;
+		action->keyButton = strtol(argument, &end, 10);
+		if (*end != '\0' || action->keyButton < 1)
+			return -1;
+	} else if (strcmp(word, "key") == 0) {
+		KeySym keysym = XStringToKeysym(argument);
+		if (keysym == NoSymbol)
+			return -1;
+		action->actionType = ACTIONTYPE_KEYPRESS;
+		action->keyButton = keysym;
+	} else {
+		return -1;
+	}
+
+	while ((word = strtok_r(NULL, " \t", &savePtr)) != NULL) {
+		if (strcmp(word, "shift") == 0) action->modifier |= MODIFIER_SHIFT;
+		else if (strcmp(word, "ctrl") == 0 || strcmp(word, "control") == 0) action->modifier |= MODIFIER_CONTROL;
+		else if (strcmp(word, "alt") == 0) action->modifier |= MODIFIER_ALT;
+		else if (strcmp(word, "super") == 0) action->modifier |= MODIFIER_SUPER;
+		else return -1;
+	}
+	return 0;
+}
+
+/* Is the value within the range of the setting? */
+static int inRange(const Setting* setting, double value) {
+	if (setting->exclusive)
+		return value > setting->minimum && value < setting->maximum;
+	return value >= setting->minimum && value <= setting->maximum;
+}
+
+/* Sets a setting of the given profile. Returns 0 on success. */
+static int parseSetting(Profile* profile, const char* name, char* value) {
+	const Setting* setting;
+	char* end;
+	long intValue;
+	double doubleValue;
+	for (setting = settings; setting->name != NULL; setting++) {
+		if (strcmp(setting->name, name) == 0)
+			break;
+	}
+	if (setting->name == NULL)
+		return -1;
+
+	char* field = (char*) profile + setting->offset;
+	switch (setting->type) {
+	case SETTING_INT:
+		intValue = strtol(value, &end, 10);
+		if (*value == '\0' || *end != '\0' || intValue < INT_MIN || intValue > INT_MAX || !inRange(setting, intValue)) return -1;
+		*((int*) field) = intValue;
+		break;
+	case SETTING_DOUBLE:
+		doubleValue = strtod(value, &end);
+		if (*value == '\0' || *end != '\0' || !inRange(setting, doubleValue)) return -1;
+		*((double*) field) = doubleValue;
+		break;
+	case SETTING_BOOL:
+		if (strcmp(value, "yes") == 0 || strcmp(value, "true") == 0 || strcmp(value, "1") == 0) *((int*) field) = 1;
+		else if (strcmp(value, "no") == 0 || strcmp(value, "false") == 0 || strcmp(value, "0") == 0) *((int*) field) = 0;
+		else return -1;
+		break;
+	case SETTING_ACTION:
+		if (parseAction(value, (Action*) field) != 0) return -1;
+		break;
+	}
+	*((int*) ((char*) profile + setting->inheritOffset)) = 0;
+	return 0;
+}
+
+#define SECTION_NONE 0
+#define SECTION_DEFAULT 1
+#define SECTION_PROFILE 2
+#define SECTION_BLACKLIST 3
+#define SECTION_WM_BLACKLIST 4
+
+/* Parses the given configuration file. Returns 0 on success. */
+static int parseConfigFile(const char* fileName, ParsedConfig* config) {
+	char line[MAX_CONFIG_LINE];
+	int lineNumber = 0;
+	int section = SECTION_NONE;
+	int i;
+	Profile* profile = NULL;
+
+	FILE* file = fopen(fileName, "r");
+	if (file == NULL) {
+		fprintf(stderr, "Couldn't read %s: %s\n", fileName, strerror(errno));
+		return -1;
+	}
+
+	memset(config, 0, sizeof(ParsedConfig));
+	config->defaultProfile = *getBuiltInDefaultProfile();
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		lineNumber++;
+		char* s = trim(line);
+		if (*s == '\0' || *s == '#')
+			continue;
+
+		if (*s == '[') {
+			char* end = strchr(s, ']');
+			if (end == NULL || end[1] != '\0')
+				goto syntaxError;
+			*end = '\0';
+			s = trim(s + 1);
+			if (strcmp(s, "default") == 0) {
+				section = SECTION_DEFAULT;
+				profile = &(config->defaultProfile);
+			} else if (strcmp(s, "blacklist") == 0) {
+				section = SECTION_BLACKLIST;
+			} else if (strcmp(s, "wm-blacklist") == 0) {
+				section = SECTION_WM_BLACKLIST;
+			} else if (strncmp(s, "profile", 7) == 0 && isspace((unsigned char) s[7])) {
+				Profile* profiles = realloc(config->profiles, (config->profileCount + 1) * sizeof(Profile));
+				if (profiles == NULL)
+					goto outOfMemory;
+				config->profiles = profiles;
+				if (appendOffset(&(config->profileClasses), &(config->profileCount), addString(config, trim(s + 7))) != 0)
+					goto outOfMemory;
+				section = SECTION_PROFILE;
+				profile = &(config->profiles[config->profileCount - 1]);
+				memset(profile, 0, sizeof(Profile));
+				for (i = 0; i < sizeof(inheritOffsets) / sizeof(inheritOffsets[0]); i++) {
+					*((int*) ((char*) profile + inheritOffsets[i])) = 1;
+				}
+			} else {
+				goto syntaxError;
+			}
+			continue;
+		}
+
+		switch (section) {
+		case SECTION_BLACKLIST:
+			if (appendOffset(&(config->blacklist), &(config->blacklistCount), addString(config, s)) != 0)
+				goto outOfMemory;
+			break;
+		case SECTION_WM_BLACKLIST:
+			if (appendOffset(&(config->wmBlacklist), &(config->wmBlacklistCount), addString(config, s)) != 0)
+				goto outOfMemory;
+			break;
+		case SECTION_DEFAULT:
+		case SECTION_PROFILE:
+			;
+			char* equals = strchr(s, '=');
+			if (equals == NULL)
+				goto syntaxError;
+			*equals = '\0';
+			if (parseSetting(profile, trim(s), trim(equals + 1)) != 0)
+				goto syntaxError;
+			break;
+		default:
+			goto syntaxError;
+		}
+	}
+
+	/* The default profile can't inherit from anything */
+	for (i = 0; i < sizeof(inheritOffsets) / sizeof(inheritOffsets[0]); i++) {
+		*((int*) ((char*) &(config->defaultProfile) + inheritOffsets[i])) = 0;
+	}
+	fclose(file);
+	return 0;
+
+syntaxError:
+	fprintf(stderr, "%s:%i: Syntax error\n", fileName, lineNumber);
+	fclose(file);
+	freeParsedConfig(config);
+	return -1;
+
+outOfMemory:
+	fprintf(stderr, "%s: Out of memory\n", fileName);
+	fclose(file);
+	freeParsedConfig(config);
+	return -1;
+}
+
+
+/* Profile sets */
+
+/* Makes a profile set of the given configuration; the strings have to stay valid as
+ * long as the set exists. Returns NULL if out of memory. */
+static ProfileSet* buildProfileSet(const ParsedConfig* config) {
+	uint32_t i;
+	ProfileSet* set = calloc(1, sizeof(ProfileSet));
+	if (set == NULL)
+		return NULL;
+	set->ownsMemory = 1;
+	set->profileCount = config->profileCount;
+	set->profiles = malloc((config->profileCount + 1) * sizeof(Profile));
+	set->blacklist = malloc((config->blacklistCount + 1) * sizeof(char*));
+	set->wmBlacklist = malloc((config->wmBlacklistCount + 1) * sizeof(char*));
+	if (set->profiles == NULL || set->blacklist == NULL || set->wmBlacklist == NULL) {
+		freeProfileSet(set);
+		return NULL;
+	}
+
+	set->defaultProfile = config->defaultProfile;
+	set->defaultProfile.windowClass = NULL;
+	for (i = 0; i < config->profileCount; i++) {
+		set->profiles[i] = config->profiles[i];
+		set->profiles[i].windowClass = config->strings + config->profileClasses[i];
+	}
+	for (i = 0; i < config->blacklistCount; i++) {
+		set->blacklist[i] = config->strings + config->blacklist[i];
+	}
+	set->blacklist[i] = NULL;
+	for (i = 0; i < config->wmBlacklistCount; i++) {
+		set->wmBlacklist[i] = config->strings + config->wmBlacklist[i];
+	}
+	set->wmBlacklist[i] = NULL;
+	return set;
+}
+
+void freeProfileSet(ProfileSet* set) {
+	freeClassMap(&(set->profileMap));
+	freeClassMap(&(set->blacklistMap));
+	freeClassMap(&(set->wmBlacklistMap));
+	if (set->ownsMemory) {
+		free(set->profiles);
+		free(set->blacklist);
+		free(set->wmBlacklist);
+		free(set->strings);
+		if (set->mapping != NULL)
+			munmap(set->mapping, set->mappingSize);
+		free(set);
+	}
+}
+
+
+/* Cache */
+
+/* Does the offset point to a string in the cache? */
+static int validOffsets(const uint32_t* offsets, uint32_t count, uint32_t stringsSize) {
+	uint32_t i;
+	for (i = 0; i < count; i++) {
+		if (offsets[i] >= stringsSize)
+			return 0;
+	}
+	return 1;
+}
+
+/* Maps the cache if it was made from the current version of the configuration file.
+ * Returns NULL otherwise. */
+static ProfileSet* loadCache(const char* cacheFile, const char* configFile, const struct stat* configStat) {
+	struct stat cacheStat;
+	ParsedConfig config;
+	ProfileSet* set = NULL;
+
+	int fileDesc = open(cacheFile, O_RDONLY | O_CLOEXEC);
+	if (fileDesc < 0)
+		return NULL;
+	if (fstat(fileDesc, &cacheStat) != 0 || cacheStat.st_size < sizeof(ConfigCacheHeader)) {
+		close(fileDesc);
+		return NULL;
+	}
+	size_t size = cacheStat.st_size;
+	char* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDesc, 0);
+	close(fileDesc);
+	if (mapping == MAP_FAILED)
+		return NULL;
+
+	const ConfigCacheHeader* header = (const ConfigCacheHeader*) mapping;
+	uint64_t expectedSize = sizeof(ConfigCacheHeader) + sizeof(Profile) * (1 + (uint64_t) header->profileCount)
+			+ sizeof(uint32_t) * ((uint64_t) header->profileCount + header->blacklistCount + header->wmBlacklistCount)
+			+ header->stringsSize;
+	if (memcmp(header->magic, CONFIG_CACHE_MAGIC, 8) != 0 || header->profileSize != sizeof(Profile)
+			|| expectedSize != size || header->stringsSize == 0
+			|| header->sourceMtimeSec != configStat->st_mtim.tv_sec
+			|| header->sourceMtimeNsec != configStat->st_mtim.tv_nsec
+			|| header->sourceSize != configStat->st_size) {
+		munmap(mapping, size);
+		return NULL;
+	}
+
+	char* position = mapping + sizeof(ConfigCacheHeader);
+	memset(&config, 0, sizeof(config));
+	memcpy(&(config.defaultProfile), position, sizeof(Profile));
+	position += sizeof(Profile);
+	config.profiles = (Profile*) position;
+	config.profileCount = header->profileCount;
+	position += sizeof(Profile) * header->profileCount;
+	config.profileClasses = (uint32_t*) position;
+	position += sizeof(uint32_t) * header->profileCount;
+	config.blacklist = (uint32_t*) position;
+	config.blacklistCount = header->blacklistCount;
+	position += sizeof(uint32_t) * header->blacklistCount;
+	config.wmBlacklist = (uint32_t*) position;
+	config.wmBlacklistCount = header->wmBlacklistCount;
+	position += sizeof(uint32_t) * header->wmBlacklistCount;
+	config.strings = position;
+	config.stringsSize = header->stringsSize;
+
+	if (config.strings[config.stringsSize - 1] == '\0'
+			&& validOffsets(config.profileClasses, config.profileCount, config.stringsSize)
+			&& validOffsets(config.blacklist, config.blacklistCount, config.stringsSize)
+			&& validOffsets(config.wmBlacklist, config.wmBlacklistCount, config.stringsSize)
+			&& header->sourceName < config.stringsSize
+			&& strcmp(config.strings + header->sourceName, configFile) == 0) {
+		set = buildProfileSet(&config);
+	}
+	if (set == NULL) {
+		munmap(mapping, size);
+		return NULL;
+	}
+	set->mapping = mapping;
+	set->mappingSize = size;
+	return set;
+}
+
+static int writeAll(int fileDesc, const void* data, size_t length) {
+	return length == 0 || write(fileDesc, data, length) == length ? 0 : -1;
+}
+
+/* Writes the cache of the given configuration. Failing is harmless, the file is just
+ * parsed again next time. */
+static void writeCache(const char* cacheFile, ParsedConfig* config, const char* configFile, const struct stat* configStat) {
+	ConfigCacheHeader header;
+	char tempFile[4096];
+	char directory[4096];
+
+	long sourceName = addString(config, configFile);
+	if (sourceName < 0 || snprintf(tempFile, sizeof(tempFile), "%s.%i", cacheFile, (int) getpid()) >= sizeof(tempFile))
+		return;
+
+	/* Create the cache directory and its parents if needed */
+	strncpy(directory, cacheFile, sizeof(directory) - 1);
+	directory[sizeof(directory) - 1] = '\0';
+	char* slash;
+	for (slash = strchr(directory + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		mkdir(directory, 0755);
+		*slash = '/';
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CONFIG_CACHE_MAGIC, 8);
+	header.profileSize = sizeof(Profile);
+	header.profileCount = config->profileCount;
+	header.blacklistCount = config->blacklistCount;
+	header.wmBlacklistCount = config->wmBlacklistCount;
+	header.stringsSize = config->stringsSize;
+	header.sourceName = sourceName;
+	header.sourceMtimeSec = configStat->st_mtim.tv_sec;
+	header.sourceMtimeNsec = configStat->st_mtim.tv_nsec;
+	header.sourceSize = configStat->st_size;
+
+	int fileDesc = open(tempFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fileDesc < 0)
+		return;
+	int result = writeAll(fileDesc, &header, sizeof(header))
+			| writeAll(fileDesc, &(config->defaultProfile), sizeof(Profile))
+			| writeAll(fileDesc, config->profiles, sizeof(Profile) * config->profileCount)
+			| writeAll(fileDesc, config->profileClasses, sizeof(uint32_t) * config->profileCount)
+			| writeAll(fileDesc, config->blacklist, sizeof(uint32_t) * config->blacklistCount)
+			| writeAll(fileDesc, config->wmBlacklist, sizeof(uint32_t) * config->wmBlacklistCount)
+			| writeAll(fileDesc, config->strings, config->stringsSize);
+	close(fileDesc);
+
+	/* Replace the old cache atomically */
+	if (result != 0 || rename(tempFile, cacheFile) != 0) {
+		unlink(tempFile);
+	}
+}
+
+/* Loads the profiles from the given configuration file, from its cache if that is up to
+ * date (cacheFile may be NULL). Returns NULL on failure. */
+ProfileSet* loadProfileSet(const char* configFile, const char* cacheFile) {
+	struct stat configStat;
+	ParsedConfig config;
+	ProfileSet* set;
+
+	if (stat(configFile, &configStat) != 0) {
+		fprintf(stderr, "Couldn't read %s: %s\n", configFile, strerror(errno));
+		return NULL;
+	}
+
+	if (cacheFile != NULL && (set = loadCache(cacheFile, configFile, &configStat)) != NULL) {
+		if (inDebugMode()) printf("Loaded profiles from cache %s\n", cacheFile);
+		return set;
+	}
+
+	if (parseConfigFile(configFile, &config) != 0)
+		return NULL;
+	if (cacheFile != NULL) {
+		writeCache(cacheFile, &config, configFile, &configStat);
+	}
+	set = buildProfileSet(&config);
+	if (set == NULL) {
+		freeParsedConfig(&config);
+		return NULL;
+	}
+	/* The set keeps the strings */
+	set->strings = config.strings;
+	config.strings = NULL;
+	freeParsedConfig(&config);
+	if (inDebugMode()) printf("Loaded profiles from %s\n", configFile);
+	return set;
+}
+
+/* Builds the path of a file in an XDG base directory. Returns a malloc'ed string. */
+static char* xdgPath(const char* variable, const char* fallback, const char* name) {
+	const char* base = getenv(variable);
+	const char* home = getenv("HOME");
+	char* path;
+	if (base != NULL && base[0] == '/') {
+		fallback = NULL;
+	} else if (home != NULL) {
+		base = home;
+	} else {
+		return NULL;
+	}
+
+	size_t length = strlen(base) + (fallback != NULL ? strlen(fallback) + 1 : 0) + strlen(name) + 2;
+	if ((path = malloc(length)) == NULL)
+		return NULL;
+	if (fallback != NULL) {
+		snprintf(path, length, "%s/%s/%s", base, fallback, name);
+	} else {
+		snprintf(path, length, "%s/%s", base, name);
+	}
+	return path;
+}
+
+/* Returns the configuration file to use (a malloc'ed string): the user's if there is one,
+ * otherwise the system-wide one. NULL if there is none. */
+char* findConfigFile() {
+	char* path = xdgPath("XDG_CONFIG_HOME", ".config", CONFIG_FILE_NAME);
+	if (path != NULL && access(path, R_OK) == 0)
+		return path;
+	free(path);
+	if (access(SYSTEM_CONFIG_FILE, R_OK) == 0)
+		return strdup(SYSTEM_CONFIG_FILE);
+	return NULL;
+}
+
+/* Returns the path of the cache file (a malloc'ed string), or NULL */
+char* getConfigCacheFile() {
+	return xdgPath("XDG_CACHE_HOME", ".cache", CACHE_DIR_NAME "/" CACHE_FILE_NAME);
+}
@@ -0,0 +1,81 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include "classes.h"
+
+/* Profiles and blacklists, either the built-in ones from profiles.h or loaded from a
+ * configuration file. A set is replaced as a whole when the configuration is reloaded. */
+
+typedef struct ProfileSet ProfileSet;
+
+struct ProfileSet {
+	Profile* profiles;
+	int profileCount;
+	Profile defaultProfile;
+	/* NULL-terminated lists of window classes */
+	char** blacklist;
+	char** wmBlacklist;
+
+	/* Lookup tables, built by the gesture code */
+	ClassMap profileMap;
+	ClassMap blacklistMap;
+	ClassMap wmBlacklistMap;
+
+	/* Does the memory of profiles, blacklist and wmBlacklist belong to the set? */
+	int ownsMemory;
+	/* Storage of the strings: either the mapped cache file or a buffer of the parser */
+	void* mapping;
+	size_t mappingSize;
+	char* strings;
+
+	/* Sets replaced while a gesture was using them */
+	ProfileSet* nextRetired;
+};
+
+/* Binary cache of a parsed configuration file:
+ * header, default profile, profiles, class name offsets of the profiles,
+ * blacklist offsets, wm blacklist offsets, strings. The window classes in the stored
+ * profiles are meaningless; the offsets point into the strings. */
+#define CONFIG_CACHE_MAGIC "TWOFCFG2"
+
+typedef struct ConfigCacheHeader ConfigCacheHeader;
+
+struct ConfigCacheHeader {
+	char magic[8];
+	/* The layout of Profile may differ between builds */
+	uint32_t profileSize;
+	uint32_t profileCount;
+	uint32_t blacklistCount;
+	uint32_t wmBlacklistCount;
+	uint32_t stringsSize;
+	/* Offset of the name of the configuration file in the strings */
+	uint32_t sourceName;
+	/* The configuration file the cache was made from */
+	int64_t sourceMtimeSec;
+	int64_t sourceMtimeNsec;
+	int64_t sourceSize;
+};
+
+ProfileSet* loadProfileSet(const char* configFile, const char* cacheFile);
+void freeProfileSet(ProfileSet* set);
+char* findConfigFile();
+char* getConfigCacheFile();
+
+#endif /* CONFIG_H_ */
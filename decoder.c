@@ -0,0 +1,489 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <linux/input.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include "decoder.h"
+
+/* Operations of the decoder table */
+#define DECODE_OP_IGNORE 0
+/* Store value into a field of the current finger */
+#define DECODE_OP_STORE 1
+#define DECODE_OP_SLOT 2
+#define DECODE_OP_SLOT_TRACKING_ID 3
+#define DECODE_OP_SLOT_REPORT 4
+/* MT_SYNC seen while expecting slots: the device speaks the legacy protocol */
+#define DECODE_OP_SWITCH_TO_LEGACY 5
+#define DECODE_OP_LEGACY_TRACKING_ID 6
+#define DECODE_OP_LEGACY_MT_REPORT 7
+#define DECODE_OP_LEGACY_REPORT 8
+/* The kernel dropped events: ignore everything up to the next SYN_REPORT, then resync */
+#define DECODE_OP_DROPPED 9
+#define DECODE_OP_RESYNC 10
+
+#define STORE(field) { DECODE_OP_STORE, offsetof(FingerInfo, field) }
+
+/* Multi-touch protocol B (slots) */
+static const DecodeEntry slotTable[DECODE_TABLE_SIZE] = {
+	[DECODE_INDEX(EV_SYN, SYN_REPORT)] = { DECODE_OP_SLOT_REPORT, 0 },
+	[DECODE_INDEX(EV_SYN, SYN_MT_REPORT)] = { DECODE_OP_SWITCH_TO_LEGACY, 0 },
+	[DECODE_INDEX(EV_SYN, SYN_DROPPED)] = { DECODE_OP_DROPPED, 0 },
+	[DECODE_INDEX(EV_ABS, ABS_MT_SLOT)] = { DECODE_OP_SLOT, 0 },
+	[DECODE_INDEX(EV_ABS, ABS_MT_TRACKING_ID)] = { DECODE_OP_SLOT_TRACKING_ID, 0 },
+	[DECODE_INDEX(EV_ABS, ABS_MT_POSITION_X)] = STORE(rawX),
+	[DECODE_INDEX(EV_ABS, ABS_MT_POSITION_Y)] = STORE(rawY),
+	[DECODE_INDEX(EV_ABS, ABS_MT_PRESSURE)] = STORE(rawZ)
+};
+
+/* Multi-touch protocol A (legacy) */
+static const DecodeEntry legacyTable[DECODE_TABLE_SIZE] = {
+	[DECODE_INDEX(EV_SYN, SYN_REPORT)] = { DECODE_OP_LEGACY_REPORT, 0 },
+	[DECODE_INDEX(EV_SYN, SYN_MT_REPORT)] = { DECODE_OP_LEGACY_MT_REPORT, 0 },
+	[DECODE_INDEX(EV_SYN, SYN_DROPPED)] = { DECODE_OP_DROPPED, 0 },
+	[DECODE_INDEX(EV_ABS, ABS_MT_TRACKING_ID)] = { DECODE_OP_LEGACY_TRACKING_ID, 0 },
+	[DECODE_INDEX(EV_ABS, ABS_MT_POSITION_X)] = STORE(rawX),
+	[DECODE_INDEX(EV_ABS, ABS_MT_POSITION_Y)] = STORE(rawY),
+	[DECODE_INDEX(EV_ABS, ABS_MT_PRESSURE)] = STORE(rawZ)
+};
+
+/* After SYN_DROPPED, for both protocols */
+static const DecodeEntry droppedTable[DECODE_TABLE_SIZE] = {
+	[DECODE_INDEX(EV_SYN, SYN_REPORT)] = { DECODE_OP_RESYNC, 0 }
+};
+
+
+static int testBit(const unsigned long* bits, int bit) {
+	int bitsPerLong = 8 * sizeof(unsigned long);
+	return (bits[bit / bitsPerLong] >> (bit % bitsPerLong)) & 1;
+}
+
+static void switchToLegacyProtocol(Decoder* decoder) {
+	decoder->useLegacyProtocol = 1;
+	decoder->currentSlot = -1;
+	decoder->tempFingerInfo.slotUsed = 0;
+	decoder->target = &(decoder->tempFingerInfo);
+	decoder->table = legacyTable;
+}
+
+static void selectSlot(Decoder* decoder, int slot) {
+	if (slot < 0 || slot >= decoder->slotCount) {
+		decoder->currentSlot = -1;
+		decoder->target = &(decoder->ignoredFinger);
+	} else {
+		decoder->currentSlot = slot;
+		decoder->target = &(decoder->slots[slot]);
+	}
+}
+
+/* A finger touched down on the given slot: append it to the contacts. */
+static void addContact(Decoder* decoder, int slot) {
+	decoder->slots[slot].slotUsed = 1;
+	decoder->contactSlots[decoder->activeCount] = slot;
+	decoder->slotToContact[slot] = decoder->activeCount;
+	decoder->activeCount++;
+}
+
+/* The finger on the given slot has been released: remove it from the contacts, keeping
+ * the others in touch-down order. */
+static void removeContact(Decoder* decoder, int slot) {
+	int i;
+	decoder->slots[slot].slotUsed = 0;
+	for (i = decoder->slotToContact[slot] + 1; i < decoder->activeCount; i++) {
+		decoder->contactSlots[i - 1] = decoder->contactSlots[i];
+		decoder->slotToContact[decoder->contactSlots[i]] = i - 1;
+	}
+	decoder->slotToContact[slot] = -1;
+	decoder->activeCount--;
+}
+
+/* Tracking id lookup for the legacy protocol */
+
+static int findSlotForId(Decoder* decoder, int id) {
+	int i = id & decoder->idTableMask;
+	while (decoder->idTableSlots[i] != -1) {
+		if (decoder->idTableIds[i] == id)
+			return decoder->idTableSlots[i];
+		i = (i + 1) & decoder->idTableMask;
+	}
+	return -1;
+}
+
+static void insertId(Decoder* decoder, int id, int slot) {
+	int i = id & decoder->idTableMask;
+	while (decoder->idTableSlots[i] != -1) {
+		i = (i + 1) & decoder->idTableMask;
+	}
+	decoder->idTableIds[i] = id;
+	decoder->idTableSlots[i] = slot;
+}
+
+static void removeId(Decoder* decoder, int id) {
+	int mask = decoder->idTableMask;
+	int i = id & mask;
+	while (decoder->idTableSlots[i] != -1 && decoder->idTableIds[i] != id) {
+		i = (i + 1) & mask;
+	}
+	if (decoder->idTableSlots[i] == -1)
+		return;
+
+	/* Shift following entries back so that no lookup chain is broken */
+	int j = i;
+	while (1) {
+		decoder->idTableSlots[i] = -1;
+		while (1) {
+			j = (j + 1) & mask;
+			if (decoder->idTableSlots[j] == -1)
+				return;
+			int home = decoder->idTableIds[j] & mask;
+			/* Entry at j may move to i if its home position is not in (i, j] */
+			if (i <= j ? (home <= i || home > j) : (home <= i && home > j))
+				break;
+		}
+		decoder->idTableIds[i] = decoder->idTableIds[j];
+		decoder->idTableSlots[i] = decoder->idTableSlots[j];
+		i = j;
+	}
+}
+
+static void setSlotTrackingId(Decoder* decoder, int value) {
+	int slot = decoder->currentSlot;
+	if (slot == -1)
+		return;
+
+	if (value == -1) {
+		if (decoder->slots[slot].slotUsed)
+			removeContact(decoder, slot);
+	} else {
+		decoder->slots[slot].id = value;
+		if (!decoder->slots[slot].slotUsed)
+			addContact(decoder, slot);
+	}
+}
+
+/* Finger info for one finger collected in tempFingerInfo, so save it to its slot. */
+static void commitLegacyFinger(Decoder* decoder) {
+	FingerInfo* temp = &(decoder->tempFingerInfo);
+	if (!temp->slotUsed)
+		return;
+
+	/* Look for slot to put the data into by looking at the tracking ids */
+	int slot = findSlotForId(decoder, temp->id);
+
+	if (slot == -1) {
+		int i;
+		for (i = 0; i < decoder->slotCount; i++) {
+			if (!decoder->slots[i].slotUsed) {
+				/* "Empty" slot, so we can add it. */
+				slot = i;
+				decoder->slots[i].id = temp->id;
+				insertId(decoder, temp->id, i);
+				addContact(decoder, i);
+				break;
+			}
+		}
+	}
+
+	if (slot != -1) {
+		/* Copy temporary data to slot */
+		decoder->slots[slot].setThisTime = 1;
+		decoder->slots[slot].rawX = temp->rawX;
+		decoder->slots[slot].rawY = temp->rawY;
+		decoder->slots[slot].rawZ = temp->rawZ;
+	}
+}
+
+/* Clears the slots not set during this frame */
+static void finishLegacyFrame(Decoder* decoder) {
+	int i;
+	for (i = decoder->activeCount - 1; i >= 0; i--) {
+		FingerInfo* slot = &(decoder->slots[decoder->contactSlots[i]]);
+		if (slot->setThisTime) {
+			slot->setThisTime = 0;
+		} else {
+			removeId(decoder, slot->id);
+			removeContact(decoder, decoder->contactSlots[i]);
+		}
+	}
+	decoder->tempFingerInfo.slotUsed = 0;
+}
+
+/* Copies the fingers that are on into the dense contact table */
+static void finishFrame(Decoder* decoder) {
+	int i;
+	for (i = 0; i < decoder->activeCount; i++) {
+		decoder->contacts[i] = decoder->slots[decoder->contactSlots[i]];
+	}
+	decoder->contactCount = decoder->activeCount;
+	decoder->resynced = 0;
+}
+
+/* Forgets all fingers */
+static void clearContacts(Decoder* decoder) {
+	int i;
+	for (i = decoder->activeCount - 1; i >= 0; i--) {
+		int slot = decoder->contactSlots[i];
+		if (decoder->useLegacyProtocol)
+			removeId(decoder, decoder->slots[slot].id);
+		removeContact(decoder, slot);
+	}
+}
+
+/* Reads the current values of one ABS_MT_* axis for all slots into values.
+ * Returns 0 on success, -1 on failure. */
+static int readSlotValues(Decoder* decoder, int code, int* values) {
+	struct {
+		__u32 code;
+		__s32 values[DECODER_MAX_SLOTS];
+	} request;
+	int i;
+
+	request.code = code;
+	if (ioctl(decoder->fileDesc, EVIOCGMTSLOTS(sizeof(__u32) + decoder->slotCount * sizeof(__s32)), &request) < 0)
+		return -1;
+	for (i = 0; i < decoder->slotCount; i++) {
+		values[i] = request.values[i];
+	}
+	return 0;
+}
+
+/* Rebuilds the slot state from the device after events have been dropped. */
+static void resyncSlots(Decoder* decoder) {
+	int ids[DECODER_MAX_SLOTS], xs[DECODER_MAX_SLOTS], ys[DECODER_MAX_SLOTS], zs[DECODER_MAX_SLOTS];
+	int i;
+
+	if (readSlotValues(decoder, ABS_MT_TRACKING_ID, ids) < 0) {
+		clearContacts(decoder);
+		return;
+	}
+	int hasX = readSlotValues(decoder, ABS_MT_POSITION_X, xs) == 0;
+	int hasY = readSlotValues(decoder, ABS_MT_POSITION_Y, ys) == 0;
+	int hasZ = readSlotValues(decoder, ABS_MT_PRESSURE, zs) == 0;
+
+	for (i = 0; i < decoder->slotCount; i++) {
+		FingerInfo* slot = &(decoder->slots[i]);
+		if (slot->slotUsed && ids[i] != slot->id) {
+			/* Released, maybe replaced by a new finger */
+			removeContact(decoder, i);
+		}
+		if (ids[i] != -1 && !slot->slotUsed) {
+			slot->id = ids[i];
+			addContact(decoder, i);
+		}
+		if (hasX) slot->rawX = xs[i];
+		if (hasY) slot->rawY = ys[i];
+		if (hasZ) slot->rawZ = zs[i];
+	}
+
+	struct input_absinfo slotInfo;
+	if (ioctl(decoder->fileDesc, EVIOCGABS(ABS_MT_SLOT), &slotInfo) >= 0) {
+		selectSlot(decoder, slotInfo.value);
+	}
+}
+
+/* Events have been dropped by the kernel, so query the current state of the device instead.
+ * Protocol A has no state to query; it reports all fingers in every frame, so they are just
+ * forgotten and come back with the next frame. */
+static void resync(Decoder* decoder) {
+	if (decoder->useLegacyProtocol) {
+		clearContacts(decoder);
+		decoder->tempFingerInfo.slotUsed = 0;
+		decoder->target = &(decoder->tempFingerInfo);
+		decoder->table = legacyTable;
+	} else {
+		if (decoder->fileDesc >= 0) {
+			resyncSlots(decoder);
+		} else {
+			clearContacts(decoder);
+		}
+		decoder->table = slotTable;
+	}
+
+	/* Whatever the slots say, no finger is on if the device reports BTN_TOUCH up. */
+	if (decoder->hasTouchKey) {
+		unsigned long keyBits[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+		memset(keyBits, 0, sizeof(keyBits));
+		if (ioctl(decoder->fileDesc, EVIOCGKEY(sizeof(keyBits)), keyBits) >= 0 && !testBit(keyBits, BTN_TOUCH)) {
+			clearContacts(decoder);
+		}
+	}
+
+	finishFrame(decoder);
+	decoder->resynced = 1;
+}
+
+/* Sets up the decoder. If fileDesc is a valid evdev device, the number of slots and the protocol
+ * are taken from its capabilities, otherwise protocol B is assumed until the first MT_SYNC shows up.
+ * Returns 0 on success, -1 if memory couldn't be allocated. */
+int initDecoder(Decoder* decoder, int fileDesc) {
+	int slotCount = DECODER_DEFAULT_SLOTS;
+	int hasSlots = 1;
+	int hasTouchKey = 0;
+
+	if (fileDesc >= 0) {
+		unsigned long absBits[ABS_CNT / (8 * sizeof(unsigned long)) + 1];
+		memset(absBits, 0, sizeof(absBits));
+		if (ioctl(fileDesc, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits) >= 0) {
+			hasSlots = testBit(absBits, ABS_MT_SLOT);
+		}
+
+		unsigned long keyBits[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+		memset(keyBits, 0, sizeof(keyBits));
+		if (ioctl(fileDesc, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) >= 0) {
+			hasTouchKey = testBit(keyBits, BTN_TOUCH);
+		}
+
+		struct input_absinfo slotInfo;
+		if (hasSlots && ioctl(fileDesc, EVIOCGABS(ABS_MT_SLOT), &slotInfo) >= 0) {
+			slotCount = slotInfo.maximum + 1;
+		}
+	}
+
+	if (initDecoderWithLayout(decoder, slotCount, !hasSlots) != 0)
+		return -1;
+	decoder->fileDesc = fileDesc;
+	decoder->hasTouchKey = hasTouchKey;
+	return 0;
+}
+
+/* Sets up the decoder for a device with the given number of slots and protocol, without
+ * a device to query (e.g. for replaying). Returns 0 on success, -1 if memory couldn't be allocated. */
+int initDecoderWithLayout(Decoder* decoder, int slotCount, int useLegacyProtocol) {
+	int i;
+
+	memset(decoder, 0, sizeof(Decoder));
+	decoder->fileDesc = -1;
+	decoder->slotCount = slotCount;
+	if (decoder->slotCount < 1) decoder->slotCount = 1;
+	if (decoder->slotCount > DECODER_MAX_SLOTS) decoder->slotCount = DECODER_MAX_SLOTS;
+	decoder->table = slotTable;
+
+	/* Hash table with at least twice as many entries as slots */
+	int idTableSize = 1;
+	while (idTableSize < 2 * decoder->slotCount) idTableSize *= 2;
+	decoder->idTableMask = idTableSize - 1;
+
+	decoder->slots = malloc(decoder->slotCount * sizeof(FingerInfo));
+	decoder->contacts = malloc(decoder->slotCount * sizeof(FingerInfo));
+	decoder->contactSlots = malloc(decoder->slotCount * sizeof(int));
+	decoder->slotToContact = malloc(decoder->slotCount * sizeof(int));
+	decoder->idTableIds = malloc(idTableSize * sizeof(int));
+	decoder->idTableSlots = malloc(idTableSize * sizeof(int));
+	if (decoder->slots == NULL || decoder->contacts == NULL || decoder->contactSlots == NULL
+			|| decoder->slotToContact == NULL || decoder->idTableIds == NULL || decoder->idTableSlots == NULL) {
+		freeDecoder(decoder);
+		return -1;
+	}
+
+	memset(decoder->slots, 0, decoder->slotCount * sizeof(FingerInfo));
+	for (i = 0; i < decoder->slotCount; i++) {
+		decoder->slots[i].id = -1;
+		decoder->slotToContact[i] = -1;
+	}
+	for (i = 0; i < idTableSize; i++) {
+		decoder->idTableSlots[i] = -1;
+	}
+	decoder->tempFingerInfo.id = -1;
+
+	selectSlot(decoder, 0);
+
+	if (useLegacyProtocol) {
+		/* No slots, so the device can only speak the legacy protocol. */
+		switchToLegacyProtocol(decoder);
+	}
+
+	return 0;
+}
+
+void freeDecoder(Decoder* decoder) {
+	free(decoder->slots);
+	free(decoder->contacts);
+	free(decoder->contactSlots);
+	free(decoder->slotToContact);
+	free(decoder->idTableIds);
+	free(decoder->idTableSlots);
+	decoder->slots = NULL;
+	decoder->contacts = NULL;
+	decoder->contactSlots = NULL;
+	decoder->slotToContact = NULL;
+	decoder->idTableIds = NULL;
+	decoder->idTableSlots = NULL;
+	decoder->contactCount = 0;
+}
+
+int decodeEvents(Decoder* decoder, const struct input_event* ev, int count, int* consumed) {
+	/* Kept in locals, as the stores through target could otherwise alias them */
+	const DecodeEntry* table = decoder->table;
+	char* target = (char*) decoder->target;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (ev[i].type > DECODE_MAX_TYPE || ev[i].code >= (1 << DECODE_CODE_BITS))
+			continue;
+
+		const DecodeEntry entry = table[DECODE_INDEX(ev[i].type, ev[i].code)];
+		if (entry.op == DECODE_OP_STORE) {
+			/* By far the most common case */
+			*((int*) (target + entry.offset)) = ev[i].value;
+			continue;
+		}
+
+		switch (entry.op) {
+		case DECODE_OP_SLOT:
+			selectSlot(decoder, ev[i].value);
+			target = (char*) decoder->target;
+			break;
+		case DECODE_OP_SLOT_TRACKING_ID:
+			setSlotTrackingId(decoder, ev[i].value);
+			break;
+		case DECODE_OP_SWITCH_TO_LEGACY:
+			switchToLegacyProtocol(decoder);
+			table = decoder->table;
+			target = (char*) decoder->target;
+			break;
+		case DECODE_OP_LEGACY_TRACKING_ID:
+			decoder->tempFingerInfo.id = ev[i].value;
+			decoder->tempFingerInfo.slotUsed = 1;
+			break;
+		case DECODE_OP_LEGACY_MT_REPORT:
+			commitLegacyFinger(decoder);
+			break;
+		case DECODE_OP_DROPPED:
+			table = decoder->table = droppedTable;
+			break;
+		case DECODE_OP_RESYNC:
+			decoder->frameTime.tv_sec = ev[i].input_event_sec;
+			decoder->frameTime.tv_usec = ev[i].input_event_usec;
+			resync(decoder);
+			*consumed = i + 1;
+			return DECODE_FRAME;
+		case DECODE_OP_LEGACY_REPORT:
+			finishLegacyFrame(decoder);
+			/* no break */
+		case DECODE_OP_SLOT_REPORT:
+			/* All finger data received, so process now. */
+			decoder->frameTime.tv_sec = ev[i].input_event_sec;
+			decoder->frameTime.tv_usec = ev[i].input_event_usec;
+			finishFrame(decoder);
+			*consumed = i + 1;
+			return DECODE_FRAME;
+		}
+	}
+	*consumed = count;
+	return DECODE_CONTINUE;
+}
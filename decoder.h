@@ -0,0 +1,114 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DECODER_H_
+#define DECODER_H_
+
+#include <linux/input.h>
+
+typedef struct FingerInfo FingerInfo;
+typedef struct Decoder Decoder;
+
+struct FingerInfo {
+	int x;
+	int y;
+	int rawX;
+	int rawY;
+	int rawZ;
+	int slotUsed;
+	int setThisTime; /* For legacy protocol */
+	int id; /* Tracking ID */
+};
+
+#define DECODE_CONTINUE 0
+#define DECODE_FRAME 1
+
+/* Event types up to EV_ABS and codes below 64 are looked up in the decoder table,
+ * everything else is ignored. */
+#define DECODE_MAX_TYPE EV_ABS
+#define DECODE_CODE_BITS 6
+#define DECODE_INDEX(type, code) (((type) << DECODE_CODE_BITS) | (code))
+#define DECODE_TABLE_SIZE DECODE_INDEX(DECODE_MAX_TYPE + 1, 0)
+
+/* What to do with an event of a given type and code */
+typedef struct DecodeEntry DecodeEntry;
+
+struct DecodeEntry {
+	unsigned char op;
+	/* For DECODE_OP_STORE: byte offset of the FingerInfo field that receives the value */
+	unsigned char offset;
+};
+
+/* Number of slots assumed if the device doesn't tell (legacy protocol) */
+#define DECODER_DEFAULT_SLOTS 10
+/* Upper bound for the number of slots we track */
+#define DECODER_MAX_SLOTS 64
+
+struct Decoder {
+	/* Device the events come from, -1 if unknown (then no state can be queried from it) */
+	int fileDesc;
+	/* Does the device report BTN_TOUCH? */
+	int hasTouchKey;
+	/* Number of slots, taken from ABS_MT_SLOT of the device */
+	int slotCount;
+	/* Per-slot finger state as reported by the device. The kernel only sends values that
+	   changed, so a slot keeps its last values even while no finger is on it. */
+	FingerInfo* slots;
+	/* Slots of the fingers currently on, in the order they touched down (activeCount entries),
+	   and the index of each slot in that list, -1 if no finger is on the slot. */
+	int* contactSlots;
+	int* slotToContact;
+	int activeCount;
+	/* Dense contact table of the last complete frame: the fingers that are on, in the
+	   order they touched down. */
+	FingerInfo* contacts;
+	int contactCount;
+	/* Set if the last frame has been rebuilt from the device state after the kernel dropped
+	   events; fingers may have touched or been released without being seen. */
+	int resynced;
+	/* Kernel timestamp of the SYN_REPORT that completed the last frame */
+	struct timeval frameTime;
+	/* Legacy protocol: hash table from tracking id to slot (open addressing, -1 marks an
+	   empty entry in idTableSlots) */
+	int idTableMask;
+	int* idTableIds;
+	int* idTableSlots;
+	/* Slot the next ABS_MT_* events refer to, -1 if ignored */
+	int currentSlot;
+	/* If we use the legacy protocol, we collect all data of one finger into tempFingerInfo and set
+	   it to the correct slot once MT_SYNC occurs. */
+	FingerInfo tempFingerInfo;
+	/* Does the device use the legacy MT protocol? */
+	int useLegacyProtocol;
+	/* Finger that receives the values of the next events; points to ignoredFinger for
+	   slots we don't track, so storing never needs a check. */
+	FingerInfo* target;
+	FingerInfo ignoredFinger;
+	/* Table indexed by DECODE_INDEX(type, code), chosen once for the protocol in use
+	   instead of testing it on every event. */
+	const DecodeEntry* table;
+};
+
+int initDecoder(Decoder*, int);
+int initDecoderWithLayout(Decoder*, int, int);
+void freeDecoder(Decoder*);
+
+/* Feeds events into the decoder until a frame is complete or all count events are used up.
+ * Returns DECODE_FRAME when a complete frame is available in contacts, DECODE_CONTINUE
+ * otherwise; the number of events used is stored in consumed. */
+int decodeEvents(Decoder*, const struct input_event*, int, int*);
+
+#endif /* DECODER_H_ */
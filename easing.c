@@ -14,113 +14,147 @@
  PERFORMANCE OF THIS SOFTWARE.
  */
 
+/* Easing keeps a scroll gesture going after the fingers have been lifted. Both axes go on
+ * at the speed the fingers had, slowing down exponentially with the decay of the profile:
+ * after t milliseconds an axis has covered speed * decay * (1 - e^(-t/decay)) steps. So the
+ * time of each step follows in closed form, and the steps are made at absolute deadlines. */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <pthread.h>
 #include <math.h>
 #include <X11/Xlib.h>
 #include "twofingemu.h"
 #include "easing.h"
-#include "gestures.h"
 #include <unistd.h>
+#include <sys/time.h>
+
+typedef struct {
+	/* Speed at the start in steps per millisecond */
+	double speed;
+	/* Steps made so far, and until the axis has slowed down to a step every
+	   MAX_EASING_INTERVAL milliseconds; no easing on the axis if totalSteps is 0 */
+	int steps;
+	int totalSteps;
+	/* Absolute time of the next step */
+	TimeVal deadline;
+	/* Action of each step */
+	Action* action;
+} EasingAxis;
 
 
 /* Variables for easing: */
 /* 1 if there is currently easing going on */
 int easingActive = 0;
 
-/* Start Interval between two easing steps */
-int easingInterval = 0;
-/* 1 if easing shall move to the right, -1 if it shall move to the left. */
-int easingDirectionX = 0;
-/* 1 if easing shall move down, -1 if it shall move up. */
-int easingDirectionY = 0;
-/* The profile for the easing */
-Profile* easingProfile;
-
-TimeVal easingStepTimeVal;
-TimeVal nonEasingTimeVal = { 5, 0 };
-
-/* Starts the easing; profile, interval and directions have to be set before. */
-void startEasing(Profile * profile, int directionX, int directionY, int interval) {
-	easingDirectionX = directionX;
-	easingDirectionY = directionY;
-	easingProfile = profile;
-	easingInterval = interval;
-	easingStepTimeVal.tv_sec = interval / 1000;
-	easingStepTimeVal.tv_usec = (interval % 1000) * 1000;
-	easingActive = 1;
+/* The axes */
+EasingAxis easingX, easingY;
+/* Time the fingers have been lifted */
+TimeVal easingStartTime;
+/* Milliseconds in which the speed drops to 1/e */
+double easingDecay;
+
+/* Absolute time of the next easing step on either axis */
+TimeVal easingDeadline;
+
+/* Steps covered after the given number of milliseconds */
+static double easedSteps(EasingAxis* axis, double time) {
+	return axis->speed * easingDecay * (1 - exp(-time / easingDecay));
+}
+
+/* Absolute time at which the given number of steps have been covered */
+static TimeVal easedTime(EasingAxis* axis, int steps) {
+	double time = -easingDecay * log(1 - steps / (axis->speed * easingDecay));
+	return timeAdd(easingStartTime, (int) ceil(time));
+}
+
+static void startAxis(EasingAxis* axis, int pixelsPerSecond, int step, Action* positive, Action* negative) {
+	axis->steps = 0;
+	axis->totalSteps = 0;
+	if (pixelsPerSecond == 0 || step <= 0)
+		return;
+
+	axis->speed = fabs(pixelsPerSecond / 1000.0 / step);
+	axis->action = pixelsPerSecond > 0 ? positive : negative;
+	/* The axis stops at a speed of one step per MAX_EASING_INTERVAL, which it reaches
+	   after covering decay * (speed - 1 / MAX_EASING_INTERVAL) steps */
+	double totalSteps = easingDecay * (axis->speed - 1.0 / MAX_EASING_INTERVAL);
+	if (totalSteps >= 1) {
+		axis->totalSteps = totalSteps < MAX_EASING_STEPS ? (int) totalSteps : MAX_EASING_STEPS;
+		axis->deadline = easedTime(axis, 1);
+	}
+}
+
+/* Makes the steps of the axis that are due at the given time */
+static void performAxisSteps(EasingAxis* axis, TimeVal currentTime) {
+	if (axis->steps == axis->totalSteps || timercmp(&currentTime, &(axis->deadline), <))
+		return;
+
+	/* All steps due by now, which is at least the one whose deadline has passed */
+	int steps = (int) easedSteps(axis, timeDiff(easingStartTime, currentTime));
+	if (steps <= axis->steps)
+		steps = axis->steps + 1;
+	if (steps > axis->totalSteps)
+		steps = axis->totalSteps;
+
+	if(inDebugMode()) printf("Easing step\n");
+	for (; axis->steps < steps; axis->steps++) {
+		executeAction(axis->action, EXECUTEACTION_BOTH);
+	}
+	if (axis->steps < axis->totalSteps)
+		axis->deadline = easedTime(axis, axis->steps + 1);
+}
+
+/* Updates easingDeadline and easingActive from the axes */
+static void updateEasingDeadline() {
+	int activeX = easingX.steps < easingX.totalSteps;
+	int activeY = easingY.steps < easingY.totalSteps;
+	easingActive = activeX || activeY;
+	if (activeX && (!activeY || timercmp(&(easingX.deadline), &(easingY.deadline), <))) {
+		easingDeadline = easingX.deadline;
+	} else if (activeY) {
+		easingDeadline = easingY.deadline;
+	}
+}
+
+/* Starts the easing with the speed of the fingers in pixels per second (positive is right
+ * and down) when they were lifted at startTime. */
+void startEasing(Profile * profile, int speedX, int speedY, TimeVal startTime) {
+	easingStartTime = startTime;
+	easingDecay = profile->scrollEasingDecay > 0 ? profile->scrollEasingDecay : DEFAULT_EASING_DECAY;
+	startAxis(&easingX, speedX, profile->hscrollStep, &(profile->scrollRightAction), &(profile->scrollLeftAction));
+	startAxis(&easingY, speedY, profile->vscrollStep, &(profile->scrollDownAction), &(profile->scrollUpAction));
+	updateEasingDeadline();
 }
 
 /* Stops the easing. */
 void stopEasing() {
 	if(easingActive) {
+		easingX.totalSteps = easingX.steps;
+		easingY.totalSteps = easingY.steps;
 		easingActive = 0;
 	}
 }
 
+/* Performs the easing steps whose deadlines have passed. */
 void checkEasingStep()
 {
-	if(easingActive && easingStepTimeVal.tv_sec <= 0 && easingStepTimeVal.tv_usec <= 0)
+	TimeVal currentTime = getCurrentTime();
+	if(easingActive && !timercmp(&currentTime, &easingDeadline, <))
 	{
-		
-		if(inDebugMode()) printf("Easing step\n");
-		if (easingProfile->scrollInherit) {
-			if(easingDirectionY == -1) {
-				executeAction(&(getDefaultProfile()->scrollUpAction),
-					EXECUTEACTION_BOTH);
-			}
-			if(easingDirectionY == 1) {
-				executeAction(&(getDefaultProfile()->scrollDownAction),
-					EXECUTEACTION_BOTH);
-			}
-			if(easingDirectionX == -1) {
-				executeAction(&(getDefaultProfile()->scrollLeftAction),
-					EXECUTEACTION_BOTH);
-			}
-			if(easingDirectionX == 1) {
-				executeAction(&(getDefaultProfile()->scrollRightAction),
-					EXECUTEACTION_BOTH);
-			}
-		} else {
-			if(easingDirectionY == -1) {
-				executeAction(&(easingProfile->scrollUpAction),
-					EXECUTEACTION_BOTH);
-			}
-			if(easingDirectionY == 1) {
-				executeAction(&(easingProfile->scrollDownAction),
-					EXECUTEACTION_BOTH);
-			}
-			if(easingDirectionX == -1) {
-				executeAction(&(easingProfile->scrollLeftAction),
-					EXECUTEACTION_BOTH);
-			}
-			if(easingDirectionX == 1) {
-				executeAction(&(easingProfile->scrollRightAction),
-					EXECUTEACTION_BOTH);
-			}
-		}
-
-
-		easingInterval = (int) (((float) easingInterval) * 1.15);
-
-		easingStepTimeVal.tv_sec = easingInterval / 1000;
-		easingStepTimeVal.tv_usec = (easingInterval % 1000) * 1000;
-
-		if(easingInterval > MAX_EASING_INTERVAL) {
-			easingActive = 0;
-		}
-
-	 }
+		performAxisSteps(&easingY, currentTime);
+		performAxisSteps(&easingX, currentTime);
+		updateEasingDeadline();
+	}
 }
 
-TimeVal* getEasingStepTimeVal()
+/* Returns the time of the next easing step, or NULL if there is no easing going on. */
+TimeVal* getEasingDeadline()
 {
 	if(easingActive) {
-		return &easingStepTimeVal;
+		return &easingDeadline;
 	} else {
-		return &nonEasingTimeVal;
+		return NULL;
 	}
 }
 
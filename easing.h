@@ -20,14 +20,19 @@
 
 /* Maximum amount of milliseconds between two scrolling steps before easing stops. */
 #define MAX_EASING_INTERVAL 200
-/* Maximum amount of milliseconds between the last two scrolling steps for easing to start. */
+/* Maximum amount of milliseconds between two scrolling steps, at the speed the fingers
+   had when they were lifted, for easing to start. */
 #define MAX_EASING_START_INTERVAL 200
+/* Decay of profiles that don't set scroll.easing-decay, in milliseconds */
+#define DEFAULT_EASING_DECAY 500
+/* Most steps of one easing per axis */
+#define MAX_EASING_STEPS 10000
 
 
-void startEasing(Profile *, int, int, int);
+void startEasing(Profile *, int, int, TimeVal);
 void stopEasing();
 int isEasingActive();
-TimeVal* getEasingStepTimeVal();
+TimeVal* getEasingDeadline();
 void checkEasingStep();
 
 #endif /* EASING_H_ */
@@ -0,0 +1,206 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Jitter filter for the finger positions: a 1€ filter (Casiez, Roussel, Vogel 2012) per
+ * finger. It is a low pass whose cutoff rises with the speed of the finger, so a resting
+ * finger is smoothed heavily and a moving one follows with little lag. Optionally the
+ * position is extrapolated a few milliseconds ahead along the filtered velocity, to make
+ * up for the latency of the whole chain. */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "filter.h"
+
+/* Time assumed between frames that carry the same timestamp, in seconds */
+#define MIN_FRAME_INTERVAL 0.001
+
+void initTouchFilter(TouchFilter* filter, FilterSettings* settings) {
+	memset(filter, 0, sizeof(TouchFilter));
+	filter->settings = *settings;
+}
+
+/* Forgets all fingers, the next frame is passed on as it is */
+void resetTouchFilter(TouchFilter* filter) {
+	int i;
+	for (i = 0; i < MAX_FILTERED_CONTACTS; i++) {
+		filter->contacts[i].used = 0;
+	}
+}
+
+/* Smoothing factor of a low pass with the given cutoff for a sample interval of dt */
+static double lowPassAlpha(double cutoff, double dt) {
+	double tau = 1.0 / (2 * M_PI * cutoff);
+	return 1.0 / (1.0 + tau / dt);
+}
+
+static double lowPass(LowPass* lp, double value, double alpha) {
+	lp->value += alpha * (value - lp->value);
+	return lp->value;
+}
+
+static ContactFilter* findContactFilter(TouchFilter* filter, int id, int* seen) {
+	int i;
+	for (i = 0; i < MAX_FILTERED_CONTACTS; i++) {
+		if (filter->contacts[i].used && !seen[i] && filter->contacts[i].id == id) {
+			seen[i] = 1;
+			return &(filter->contacts[i]);
+		}
+	}
+	return NULL;
+}
+
+static ContactFilter* startContactFilter(TouchFilter* filter, FingerInfo* contact, struct timeval time, int* seen) {
+	int i;
+	for (i = 0; i < MAX_FILTERED_CONTACTS; i++) {
+		ContactFilter* c = &(filter->contacts[i]);
+		if (!c->used && !seen[i]) {
+			seen[i] = 1;
+			c->used = 1;
+			c->id = contact->id;
+			c->time = time;
+			c->rawX = contact->x;
+			c->rawY = contact->y;
+			c->x.value = contact->x;
+			c->y.value = contact->y;
+			c->dx.value = 0;
+			c->dy.value = 0;
+			c->frames = 0;
+			return c;
+		}
+	}
+	return NULL;
+}
+
+/* Adds a position passed through the filter to the statistics */
+static void measureContact(FilterStatistics* statistics, ContactFilter* c, double rawX, double rawY, double outX, double outY, double dt) {
+	if (c->frames >= 2) {
+		double rx = rawX - 2 * c->lastRaw[0][0] + c->lastRaw[1][0];
+		double ry = rawY - 2 * c->lastRaw[0][1] + c->lastRaw[1][1];
+		double ox = outX - 2 * c->lastOut[0][0] + c->lastOut[1][0];
+		double oy = outY - 2 * c->lastOut[0][1] + c->lastOut[1][1];
+		statistics->rawJitter += rx * rx + ry * ry;
+		statistics->outJitter += ox * ox + oy * oy;
+		statistics->samples++;
+	}
+	if (c->frames >= 1) {
+		/* The output is taken to be the input delayed by the lag: out = raw - v * lag */
+		double vx = (rawX - c->lastRaw[0][0]) / (dt * 1000);
+		double vy = (rawY - c->lastRaw[0][1]) / (dt * 1000);
+		statistics->lagDot += (rawX - outX) * vx + (rawY - outY) * vy;
+		statistics->speedSquared += vx * vx + vy * vy;
+	}
+	memcpy(c->lastRaw[1], c->lastRaw[0], sizeof(c->lastRaw[0]));
+	memcpy(c->lastOut[1], c->lastOut[0], sizeof(c->lastOut[0]));
+	c->lastRaw[0][0] = rawX;
+	c->lastRaw[0][1] = rawY;
+	c->lastOut[0][0] = outX;
+	c->lastOut[0][1] = outY;
+	c->frames++;
+}
+
+static int clamp(double value, int max) {
+	if (value < 0)
+		return 0;
+	if (value > max)
+		return max;
+	return lround(value);
+}
+
+/* Filters the calibrated positions of the contacts of a frame in place; fingers are
+ * told apart by their tracking ids. Predicted positions are kept within 0..maxX and
+ * 0..maxY. */
+void filterContacts(TouchFilter* filter, FingerInfo* contacts, int count, struct timeval time, int maxX, int maxY) {
+	FilterSettings* settings = &(filter->settings);
+	int seen[MAX_FILTERED_CONTACTS] = { 0 };
+	int i;
+
+	for (i = 0; i < count; i++) {
+		FingerInfo* contact = &(contacts[i]);
+		double dt = MIN_FRAME_INTERVAL;
+		ContactFilter* c = findContactFilter(filter, contact->id, seen);
+		if (c == NULL) {
+			/* A new finger starts where it is */
+			c = startContactFilter(filter, contact, time, seen);
+			if (c == NULL)
+				continue;
+		} else {
+			struct timeval interval;
+			timersub(&time, &(c->time), &interval);
+			double seconds = interval.tv_sec + interval.tv_usec / 1000000.0;
+			if (seconds > dt)
+				dt = seconds;
+
+			double vx = (contact->x - c->rawX) / dt;
+			double vy = (contact->y - c->rawY) / dt;
+			double derivativeAlpha = lowPassAlpha(settings->derivativeCutoff, dt);
+			lowPass(&(c->dx), vx, derivativeAlpha);
+			lowPass(&(c->dy), vy, derivativeAlpha);
+
+			/* Both axes share the cutoff, taken from the speed of the finger */
+			double cutoff = settings->minCutoff + settings->beta * hypot(c->dx.value, c->dy.value);
+			double alpha = lowPassAlpha(cutoff, dt);
+			lowPass(&(c->x), contact->x, alpha);
+			lowPass(&(c->y), contact->y, alpha);
+		}
+		c->time = time;
+		c->rawX = contact->x;
+		c->rawY = contact->y;
+
+		double predictSeconds = settings->predict / 1000.0;
+		int outX = clamp(c->x.value + c->dx.value * predictSeconds, maxX);
+		int outY = clamp(c->y.value + c->dy.value * predictSeconds, maxY);
+		measureContact(&(filter->statistics), c, contact->x, contact->y, outX, outY, dt);
+		contact->x = outX;
+		contact->y = outY;
+	}
+
+	/* Fingers that are gone */
+	for (i = 0; i < MAX_FILTERED_CONTACTS; i++) {
+		if (!seen[i])
+			filter->contacts[i].used = 0;
+	}
+}
+
+/* Parses MINCUTOFF,BETA[,DCUTOFF] into the settings and enables the filter. Returns 0 on
+ * success. */
+int parseFilterSettings(const char* s, FilterSettings* settings) {
+	double minCutoff, beta, derivativeCutoff = settings->derivativeCutoff;
+	char end;
+	int count = sscanf(s, "%lf,%lf,%lf%c", &minCutoff, &beta, &derivativeCutoff, &end);
+	if ((count != 2 && count != 3) || minCutoff <= 0 || beta < 0 || derivativeCutoff <= 0)
+		return -1;
+	settings->enabled = 1;
+	settings->minCutoff = minCutoff;
+	settings->beta = beta;
+	settings->derivativeCutoff = derivativeCutoff;
+	return 0;
+}
+
+/* Prints the jitter (RMS of the second differences of the positions, before and after
+ * filtering) and the lag (least-squares fit of the output to the delayed input; negative
+ * if prediction makes it lead) */
+void printFilterStatistics(TouchFilter* filter, const char* name) {
+	FilterStatistics* statistics = &(filter->statistics);
+	if (statistics->samples == 0 || statistics->speedSquared == 0) {
+		printf("Filter of \"%s\": too few samples\n", name);
+		return;
+	}
+	printf("Filter of \"%s\": jitter RMS %.2f px raw, %.2f px filtered, lag %.1f ms\n", name,
+			sqrt(statistics->rawJitter / statistics->samples),
+			sqrt(statistics->outJitter / statistics->samples),
+			statistics->lagDot / statistics->speedSquared);
+}
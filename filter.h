@@ -0,0 +1,80 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include "decoder.h"
+
+/* Most contacts filtered per device; further ones are passed on unfiltered */
+#define MAX_FILTERED_CONTACTS 16
+
+typedef struct FilterSettings FilterSettings;
+typedef struct LowPass LowPass;
+typedef struct ContactFilter ContactFilter;
+typedef struct FilterStatistics FilterStatistics;
+typedef struct TouchFilter TouchFilter;
+
+/* Parameters of the 1€ filter: the cutoff frequency in Hz for a resting finger, how much
+ * it rises per pixel per second of speed, and the cutoff for the speed itself. */
+struct FilterSettings {
+	int enabled;
+	double minCutoff;
+	double beta;
+	double derivativeCutoff;
+	/* Milliseconds the position is extrapolated ahead, 0 for none */
+	int predict;
+};
+
+struct LowPass {
+	double value;
+};
+
+/* Filter state of one finger, followed by its tracking id */
+struct ContactFilter {
+	int used;
+	int id;
+	struct timeval time;
+	int rawX, rawY;
+	LowPass x, y, dx, dy;
+	/* For the statistics: the last two raw and output positions */
+	int frames;
+	double lastRaw[2][2];
+	double lastOut[2][2];
+};
+
+/* Measured on the positions passed through the filter */
+struct FilterStatistics {
+	long samples;
+	/* Sums of squared second differences of the raw and output positions */
+	double rawJitter, outJitter;
+	/* Sums for the least-squares fit of the lag: (raw - out) . v and |v|^2, v in px/ms */
+	double lagDot, speedSquared;
+};
+
+struct TouchFilter {
+	FilterSettings settings;
+	ContactFilter contacts[MAX_FILTERED_CONTACTS];
+	FilterStatistics statistics;
+};
+
+void initTouchFilter(TouchFilter*, FilterSettings*);
+void resetTouchFilter(TouchFilter*);
+void filterContacts(TouchFilter*, FingerInfo*, int, struct timeval, int, int);
+int parseFilterSettings(const char*, FilterSettings*);
+void printFilterStatistics(TouchFilter*, const char*);
+
+#endif /* FILTER_H_ */
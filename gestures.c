@@ -22,595 +22,962 @@
 #include <X11/Xlib.h>
 #include "profiles.h"
 #include "twofingemu.h"
-#include "gestures.h"
 #include "easing.h"
+#include "output.h"
+#include "classes.h"
+#include "config.h"
+#include "gestures.h"
 #include <unistd.h>
 
 
-/* clickMode: 0 - first finger; 1 - second finger; 2 - center */
-int clickMode;
-
-
 /* Number of milliseconds before a single click is registered, to give the user time to put down
    second finger for two-finger gestures. */
 #define CLICK_DELAY 100
 
-/* Continuation mode -- when 1, two finger gesture is continued when one finger is released. */
-#define CONTINUATION 1
-
-#if CONTINUATION
-	#define TWO_FINGERS_DOWN fingersDown == 2 && hadTwoFingersOn == 0
-	#define TWO_FINGERS_ON fingersDown > 0 && hadTwoFingersOn == 1
-	#define TWO_FINGERS_UP fingersDown == 0 && hadTwoFingersOn == 1
-#else
-	#define TWO_FINGERS_DOWN fingersDown == 2 && fingersWereDown < 2
-	#define TWO_FINGERS_ON fingersDown == 2
-	#define TWO_FINGERS_UP fingersDown < 2 && fingersWereDown == 2
-#endif
-
-
-/* Maximum distance that two fingers have been moved while they were on */
-double maxDist;
-/* The time when the first finger touched */
-TimeVal fingerDownTime;
-/* Were there once two fingers on during the current touch phase? */
-int hadTwoFingersOn = 0;
-
-/* Profile of current window, if activated */
-Profile* currentProfile = NULL;
-
-/* Gesture information */
-int amPerformingGesture = 0;
-/* Current profile has scrollBraceAction, thus mouse pointer has to be moved during scrolling */
-int dragScrolling = 0;
-
-/* position of center between fingers at start of gesture */
-int gestureStartCenterX, gestureStartCenterY;
-/* distance between two fingers at start of gesture */
-double gestureStartDist;
-/* angle of two fingers at start of gesture */
-double gestureStartAngle;
-/* current position of center between fingers */
-int currentCenterX, currentCenterY;
 
 #define PI 3.141592654
 
-/* 1 if the last X scroll command was to the right, -1 if it was to the left. */
-int lastScrollDirectionX = 0;
-/* 1 if the last Y scroll command was down, -1 if it was up. */
-int lastScrollDirectionY = 0;
-/* Time last scroll command in X/Y action was sent. */
-TimeVal lastScrollXTime;
-TimeVal lastScrollYTime;
-/* Interval between the last two X/Y scroll commands. */
-int lastScrollXIntv;
-int lastScrollYIntv;
-/*  Last values of lastScrollXIntv/lastScrollYIntv. */
-int lastLastScrollXIntv;
-int lastLastScrollYIntv;
+/* Most steps of a kind performed in one frame; any further ones follow with the next frames.
+ * Only (almost) coinciding fingers while zooming come anywhere near. */
+#define MAX_FRAME_STEPS 100
+
+/* Milliseconds before the fingers are lifted whose motion makes up the speed of the easing */
+#define SCROLL_SPEED_WINDOW 100
+
+
+/* The profiles from profiles.h */
+static ProfileSet builtInProfiles;
+
+/* The profiles in use */
+static ProfileSet* profileSet;
+
+/* Copies the groups the profile inherits into it, so that the gesture code never has to
+ * look at the default profile. The profile's own scrollEasing is kept, as it always has
+ * been used even when inheriting the scroll settings. */
+static void resolveProfile(Profile* profile, const Profile* defaultProfile) {
+	if (profile->scrollInherit) {
+		profile->scrollMinDistance = defaultProfile->scrollMinDistance;
+		profile->hscrollStep = defaultProfile->hscrollStep;
+		profile->vscrollStep = defaultProfile->vscrollStep;
+		profile->scrollBraceAction = defaultProfile->scrollBraceAction;
+		profile->scrollUpAction = defaultProfile->scrollUpAction;
+		profile->scrollDownAction = defaultProfile->scrollDownAction;
+		profile->scrollLeftAction = defaultProfile->scrollLeftAction;
+		profile->scrollRightAction = defaultProfile->scrollRightAction;
+		profile->scrollInherit = 0;
+	}
+	if (profile->zoomInherit) {
+		profile->zoomMinDistance = defaultProfile->zoomMinDistance;
+		profile->zoomMinFactor = defaultProfile->zoomMinFactor;
+		profile->zoomStep = defaultProfile->zoomStep;
+		profile->zoomInAction = defaultProfile->zoomInAction;
+		profile->zoomOutAction = defaultProfile->zoomOutAction;
+		profile->zoomInherit = 0;
+	}
+	if (profile->rotateInherit) {
+		profile->rotateMinDistance = defaultProfile->rotateMinDistance;
+		profile->rotateMinAngle = defaultProfile->rotateMinAngle;
+		profile->rotateStep = defaultProfile->rotateStep;
+		profile->rotateLeftAction = defaultProfile->rotateLeftAction;
+		profile->rotateRightAction = defaultProfile->rotateRightAction;
+		profile->rotateInherit = 0;
+	}
+	if (profile->swipeInherit) {
+		profile->swipeMinDistance = defaultProfile->swipeMinDistance;
+		profile->swipe3UpAction = defaultProfile->swipe3UpAction;
+		profile->swipe3DownAction = defaultProfile->swipe3DownAction;
+		profile->swipe3LeftAction = defaultProfile->swipe3LeftAction;
+		profile->swipe3RightAction = defaultProfile->swipe3RightAction;
+		profile->swipe4UpAction = defaultProfile->swipe4UpAction;
+		profile->swipe4DownAction = defaultProfile->swipe4DownAction;
+		profile->swipe4LeftAction = defaultProfile->swipe4LeftAction;
+		profile->swipe4RightAction = defaultProfile->swipe4RightAction;
+		profile->swipeInherit = 0;
+	}
+	if (profile->tapInherit) {
+		profile->tapAction = defaultProfile->tapAction;
+		profile->tapInherit = 0;
+	}
+}
+
+/* Replaces a value the gesture code can't handle by the one of the built-in default
+ * profile. The configuration file is checked when it is parsed; this also covers the
+ * built-in profiles and caches written by older versions. */
+#define REFUSE_UNLESS(condition, field, setting) \
+	if (!(condition)) { \
+		fprintf(stderr, "WARNING: %s of profile %s is out of range, using the default\n", setting, \
+				profile->windowClass != NULL ? profile->windowClass : "default"); \
+		profile->field = defaultProfile.field; \
+	}
+
+static void refuseInvalidValues(Profile* profile) {
+	REFUSE_UNLESS(profile->scrollMinDistance >= 0, scrollMinDistance, "scroll.min-distance");
+	REFUSE_UNLESS(profile->hscrollStep > 0, hscrollStep, "scroll.hstep");
+	REFUSE_UNLESS(profile->vscrollStep > 0, vscrollStep, "scroll.vstep");
+	REFUSE_UNLESS(profile->scrollEasingDecay >= 0, scrollEasingDecay, "scroll.easing-decay");
+	REFUSE_UNLESS(profile->zoomMinDistance >= 0, zoomMinDistance, "zoom.min-distance");
+	REFUSE_UNLESS(profile->zoomStep > 1, zoomStep, "zoom.step");
+	REFUSE_UNLESS(profile->zoomMinFactor >= 1, zoomMinFactor, "zoom.min-factor");
+	REFUSE_UNLESS(profile->rotateMinDistance >= 0, rotateMinDistance, "rotate.min-distance");
+	REFUSE_UNLESS(profile->rotateStep > 0 && profile->rotateStep < 180, rotateStep, "rotate.step");
+	REFUSE_UNLESS(profile->swipeMinDistance >= 0, swipeMinDistance, "swipe.min-distance");
+}
+
+#undef REFUSE_UNLESS
 
+/* Precomputes what the gesture checks compare against, so that they get by with
+ * squared lengths and dot and cross products. */
+static void deriveProfile(Profile* profile) {
+	refuseInvalidValues(profile);
 
+	profile->zoomMinFactorSquared = profile->zoomMinFactor * profile->zoomMinFactor;
+	profile->zoomStepSquared = profile->zoomStep * profile->zoomStep;
+	profile->zoomStepLog = log(profile->zoomStep);
 
-void initGestures(int theClickMode) {
-	clickMode = theClickMode;
+	/* Rotations start when the angle, truncated to whole degrees, exceeds rotateMinAngle */
+	double minAngle = floor(profile->rotateMinAngle) + 1;
+	if (minAngle < 0)
+		minAngle = 0;
+	profile->rotateMinAngleCos = minAngle > 180 ? -2 : cos(minAngle * PI / 180);
+
+	profile->rotateStepCos = cos(profile->rotateStep * PI / 180);
+	profile->rotateStepSin = sin(profile->rotateStep * PI / 180);
 }
 
-/* All the gesture-related code.
- * Returns 1 if the method should be called again, 0 otherwise.
- */
-int checkGesture(FingerInfo* fingerInfos, int fingersDown) {
+/* Resolves the profiles of the set and builds its lookup tables; the set then becomes
+ * the one in use. Returns the previous set. */
+ProfileSet* setProfileSet(ProfileSet* set) {
+	int i;
+	ProfileSet* previous = profileSet;
 
-	/* Calculate difference between two touch points and angle */
-	int xdiff = fingerInfos[1].x - fingerInfos[0].x;
-	int ydiff = fingerInfos[1].y - fingerInfos[0].y;
-	double currentDist = sqrt(xdiff * xdiff + ydiff * ydiff);
-	double currentAngle = atan2(ydiff, xdiff) * 180 / PI;
+	for (i = 0; i < set->profileCount; i++) {
+		resolveProfile(&(set->profiles[i]), &(set->defaultProfile));
+		deriveProfile(&(set->profiles[i]));
+	}
+	deriveProfile(&(set->defaultProfile));
+
+	initClassMap(&(set->profileMap));
+	initClassMap(&(set->blacklistMap));
+	initClassMap(&(set->wmBlacklistMap));
+	for (i = 0; i < set->profileCount; i++) {
+		addClassMapping(&(set->profileMap), set->profiles[i].windowClass, &(set->profiles[i]));
+	}
+	for (i = 0; set->blacklist[i] != NULL; i++) {
+		addClassMapping(&(set->blacklistMap), set->blacklist[i], set->blacklist[i]);
+	}
+	for (i = 0; set->wmBlacklist[i] != NULL; i++) {
+		addClassMapping(&(set->wmBlacklistMap), set->wmBlacklist[i], set->wmBlacklist[i]);
+	}
+	profileSet = set;
+	invalidateClassInfos();
+	return previous;
+}
+
+ProfileSet* getProfileSet() {
+	return profileSet;
+}
+
+void initGestures() {
+	builtInProfiles.profiles = profiles;
+	builtInProfiles.profileCount = profileCount;
+	builtInProfiles.defaultProfile = defaultProfile;
+	builtInProfiles.blacklist = blacklist;
+	builtInProfiles.wmBlacklist = wmBlacklist;
+	setProfileSet(&builtInProfiles);
+}
+
+/* If the actions for the two directions of a scroll axis are the plain buttons of one wheel,
+ * so that the axis can be scrolled smoothly, returns the wheel direction of the positive
+ * action (1 for button 5/7, -1 for button 4/6) and stores whether it is the horizontal wheel.
+ * Returns 0 otherwise. */
+static int smoothScrollDirection(Action* positive, Action* negative, int* horizontal) {
+	if (positive->actionType != ACTIONTYPE_BUTTONPRESS || negative->actionType != ACTIONTYPE_BUTTONPRESS
+			|| positive->modifier != 0 || negative->modifier != 0)
+		return 0;
+	if (positive->keyButton + negative->keyButton == 4 + 5 && (positive->keyButton == 4 || positive->keyButton == 5)) {
+		*horizontal = 0;
+		return positive->keyButton == 5 ? 1 : -1;
+	}
+	if (positive->keyButton + negative->keyButton == 6 + 7 && (positive->keyButton == 6 || positive->keyButton == 7)) {
+		*horizontal = 1;
+		return positive->keyButton == 7 ? 1 : -1;
+	}
+	return 0;
+}
+
+/* Converts the finger motion along one axis into SMOOTH_SCROLL_UNITS (a step of the
+ * profile being one unit of a wheel click), carrying over what doesn't make up a whole
+ * unit. Returns the number of units to scroll. */
+static int accumulateSmoothScroll(int movedBy, int step, int* remainder) {
+	*remainder += movedBy * SMOOTH_SCROLL_UNITS;
+	int units = *remainder / step;
+	*remainder -= units * step;
+	return units;
+}
+
+/* Adds the current center to the samples for the speed of the fingers. A change in the
+ * number of fingers moves the center, so the samples start over then. */
+static void recordScrollSample(GestureRecognizer* state, int fingersDown, TimeVal currentTime) {
+	if (fingersDown != state->scrollSampleFingers) {
+		state->scrollSampleCount = 0;
+		state->nextScrollSample = 0;
+		state->scrollSampleFingers = fingersDown;
+	}
+	ScrollSample* sample = &(state->scrollSamples[state->nextScrollSample]);
+	sample->time = currentTime;
+	sample->x = state->currentCenterX;
+	sample->y = state->currentCenterY;
+	state->nextScrollSample = (state->nextScrollSample + 1) % SCROLL_SAMPLES;
+	if (state->scrollSampleCount < SCROLL_SAMPLES)
+		state->scrollSampleCount++;
+}
+
+/* Milliseconds from start to end */
+static double sampleTimeDiff(TimeVal start, TimeVal end) {
+	return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+}
+
+/* Fits the speed of the center (in pixels per second) to the samples of the last
+ * SCROLL_SPEED_WINDOW milliseconds before currentTime, by least squares. Returns 0 if
+ * there are too few of them, or if the fingers rested before they were lifted. */
+static int estimateScrollSpeed(GestureRecognizer* state, TimeVal currentTime, double* speedX, double* speedY) {
+	double times[SCROLL_SAMPLES];
+	ScrollSample* samples[SCROLL_SAMPLES];
+	int count = 0;
+	int i;
+	for (i = 0; i < state->scrollSampleCount; i++) {
+		ScrollSample* sample = &(state->scrollSamples[(state->nextScrollSample - 1 - i + SCROLL_SAMPLES) % SCROLL_SAMPLES]);
+		double age = sampleTimeDiff(sample->time, currentTime);
+		if (age > SCROLL_SPEED_WINDOW)
+			break;
+		times[count] = -age;
+		samples[count] = sample;
+		count++;
+	}
+	if (count < 2)
+		return 0;
+
+	/* A gap to the lift-off of more than twice the usual interval between the frames
+	   means that the fingers had stopped */
+	double span = times[0] - times[count - 1];
+	if (span <= 0 || -times[0] > 2 * span / (count - 1))
+		return 0;
+
+	double meanTime = 0, meanX = 0, meanY = 0;
+	for (i = 0; i < count; i++) {
+		meanTime += times[i];
+		meanX += samples[i]->x;
+		meanY += samples[i]->y;
+	}
+	meanTime /= count;
+	meanX /= count;
+	meanY /= count;
+
+	double timeVariance = 0, covarianceX = 0, covarianceY = 0;
+	for (i = 0; i < count; i++) {
+		double time = times[i] - meanTime;
+		timeVariance += time * time;
+		covarianceX += time * (samples[i]->x - meanX);
+		covarianceY += time * (samples[i]->y - meanY);
+	}
+	*speedX = covarianceX / timeVariance * 1000;
+	*speedY = covarianceY / timeVariance * 1000;
+	return 1;
+}
+
+/* Appends an output for the owner of the recognizer to perform. The buffer is large
+ * enough for any frame, as a frame emits each kind of step only once. */
+static GestureOutput* emit(GestureRecognizer* recognizer, int type) {
+	if (recognizer->outputCount == MAX_GESTURE_OUTPUTS) {
+		/* Can't happen; rather lose the last output than write past the buffer */
+		recognizer->outputCount--;
+	}
+	GestureOutput* output = &(recognizer->outputs[recognizer->outputCount++]);
+	output->type = type;
+	return output;
+}
+
+static void emitActions(GestureRecognizer* recognizer, Action* action, int what, int count) {
+	GestureOutput* output = emit(recognizer, GESTUREOUTPUT_ACTION);
+	output->action = action;
+	output->what = what;
+	output->z = count;
+}
+
+static void emitAction(GestureRecognizer* recognizer, Action* action, int what) {
+	emitActions(recognizer, action, what, 1);
+}
+
+static void emitMove(GestureRecognizer* recognizer, int x, int y, int z) {
+	GestureOutput* output = emit(recognizer, GESTUREOUTPUT_MOVE);
+	output->x = x;
+	output->y = y;
+	output->z = z;
+}
+
+static void emitPress(GestureRecognizer* recognizer) {
+	recognizer->buttonDown = 1;
+	emit(recognizer, GESTUREOUTPUT_PRESS);
+}
+
+static void emitRelease(GestureRecognizer* recognizer) {
+	recognizer->buttonDown = 0;
+	emit(recognizer, GESTUREOUTPUT_RELEASE);
+}
+
+/* Number of steps the distance has grown beyond step, when each step is only made once
+ * the distance exceeds it; negative for negative distances. */
+static int countSteps(int distance, int step) {
+	int steps = 0;
+	if (distance > step) {
+		steps = (distance - 1) / step;
+	} else if (distance < -step) {
+		steps = -((-distance - 1) / step);
+	}
+	if (steps > MAX_FRAME_STEPS)
+		return MAX_FRAME_STEPS;
+	if (steps < -MAX_FRAME_STEPS)
+		return -MAX_FRAME_STEPS;
+	return steps;
+}
+
+/* Number of zoom steps for a ratio of squared distances that exceeds the square of the
+ * zoom step, given the logarithm of the zoom step. */
+static int countZoomSteps(double ratioSquared, double stepLog) {
+	/* Steps n for which ratio > zoomStep^n */
+	double steps = ceil(0.5 * log(ratioSquared) / stepLog) - 1;
+	if (!(steps < MAX_FRAME_STEPS))
+		return MAX_FRAME_STEPS;
+	return steps < 1 ? 1 : (int) steps;
+}
+
+/* Is the length, truncated to whole pixels, greater than minLength? */
+static int isLongerThan(double lengthSquared, int minLength) {
+	return minLength < 0 || lengthSquared >= (double) (minLength + 1) * (minLength + 1);
+}
+
+/* Does the length, truncated to whole pixels, differ from startLength by more than
+ * minDifference whole pixels? */
+static int differsBy(double lengthSquared, double startLength, int minDifference) {
+	if (minDifference < 0)
+		return 1;
+	double longer = ceil(startLength + minDifference + 1);
+	double shorter = floor(startLength - minDifference - 1) + 1;
+	return lengthSquared >= longer * longer || (shorter > 0 && lengthSquared < shorter * shorter);
+}
+
+/* Is the angle between two vectors at least the one with the given cosine? dot is their
+ * dot product, lengthsSquared the product of their squared lengths. */
+static int isAngleAtLeast(double dot, double lengthsSquared, double angleCos) {
+	if (angleCos >= 0)
+		return dot <= 0 || dot * dot <= lengthsSquared * angleCos * angleCos;
+	return dot < 0 && dot * dot >= lengthsSquared * angleCos * angleCos;
+}
+
+/* Has (vx, vy) been turned from (ux, uy) by more than the given angle (between 0 and 180
+ * degrees) in the direction in which atan2 grows? */
+static int isTurnedBeyond(double ux, double uy, double vx, double vy, double angleCos, double angleSin) {
+	double wx = ux * angleCos - uy * angleSin;
+	double wy = ux * angleSin + uy * angleCos;
+	return ux * vy - uy * vx > 0 && wx * vy - wy * vx > 0;
+}
+
+/* Number of whole steps of stepDegrees by which (vx, vy) has been turned from (ux, uy),
+ * in either direction; only called once isTurnedBeyond has found at least one. */
+static int countRotateSteps(double ux, double uy, double vx, double vy, double stepDegrees) {
+	double angle = fabs(atan2(ux * vy - uy * vx, ux * vx + uy * vy)) * 180 / PI;
+	double steps = floor(angle / stepDegrees);
+	if (!(steps < MAX_FRAME_STEPS))
+		return MAX_FRAME_STEPS;
+	return steps < 1 ? 1 : (int) steps;
+}
+
+/* All the gesture-related code: decides on a gesture and performs it. All steps the
+ * fingers have moved by since the last frame are emitted at once. */
+static void checkGesture(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, TimeVal currentTime) {
+
+	/* Calculate difference between two touch points. Only squared lengths, dot and cross
+	 * products are taken from it, so there is no square root or atan2 on each frame.
+	 * When continuing with one finger, the other one counts where it was released. */
+	FingerInfo* fingers = fingersDown >= 2 ? fingerInfos : state->gestureFingers;
+	int xdiff = fingers[1].x - fingers[0].x;
+	int ydiff = fingers[1].y - fingers[0].y;
+	double currentDistSquared = (double) xdiff * xdiff + (double) ydiff * ydiff;
 
 	/* Check distance the fingers (more exactly: the point between them)
 	 * has been moved since start of the gesture. */
-	int xdist = currentCenterX - gestureStartCenterX;
-	int ydist = currentCenterY - gestureStartCenterY;
-	double moveDist = sqrt(xdist * xdist + ydist * ydist);
-	if (moveDist > maxDist && fingersDown == 2) {
-		/* Set maxDist (but only if we are not in continuation) */
-		maxDist = moveDist;
+	int xdist = state->currentCenterX - state->gestureStartCenterX;
+	int ydist = state->currentCenterY - state->gestureStartCenterY;
+	double moveDistSquared = (double) xdist * xdist + (double) ydist * ydist;
+	if (moveDistSquared > state->maxDistSquared && fingersDown == 2) {
+		/* Set maxDistSquared (but only if we are not in continuation) */
+		state->maxDistSquared = moveDistSquared;
 	}
 
-	/* Prevent division by zero */
-	if(gestureStartDist < 1) gestureStartDist = 0;
+	/* Touch points (almost) on the same spot at start of gesture */
+	if(state->gestureStartDist < 1) state->gestureStartDist = 0;
+	double startDistSquared = state->gestureStartDist * state->gestureStartDist;
+	double startX = state->gestureStartVectorX;
+	double startY = state->gestureStartVectorY;
 
 	/* We don't know yet what to do, so look if we can decide now (only do this if there
 	   are still two fingers down, otherwise we are in continuation and can't decide). */
-	if (amPerformingGesture == GESTURE_UNDECIDED && fingersDown == 2) {
-		int scrollMinDist = currentProfile->scrollMinDistance;
-		if (currentProfile->scrollInherit)
-			scrollMinDist = defaultProfile.scrollMinDistance;
-		if ((int) moveDist > scrollMinDist) {
-			amPerformingGesture = GESTURE_SCROLL;
+	if (state->amPerformingGesture == GESTURE_UNDECIDED && fingersDown == 2) {
+		Profile* profile = state->currentProfile;
+		double zoomMinFactorSquared = profile->zoomMinFactorSquared;
+		double dot = startX * xdiff + startY * ydiff;
+		double lengthsSquared = (startX * startX + startY * startY) * currentDistSquared;
+		if (isLongerThan(moveDistSquared, profile->scrollMinDistance)) {
+			state->amPerformingGesture = GESTURE_SCROLL;
 			if(inDebugMode()) printf("Start scrolling gesture\n");
 
-			if (currentProfile->scrollInherit) {
-				executeAction(&(defaultProfile.scrollBraceAction),
-						EXECUTEACTION_PRESS);
-				if (defaultProfile.scrollBraceAction.actionType
-						== ACTIONTYPE_NONE) {
-					dragScrolling = 0;
-				} else {
-					dragScrolling = 1;
-				}
-			} else {
-				executeAction(&(currentProfile->scrollBraceAction),
-						EXECUTEACTION_PRESS);
-				if (currentProfile->scrollBraceAction.actionType
-						== ACTIONTYPE_NONE) {
-					dragScrolling = 0;
-				} else {
-					dragScrolling = 1;
-				}
-			}
-			return 1;
-		}
-
-		int zoomMinDist = currentProfile->zoomMinDistance;
-		double zoomMinFactor = currentProfile->zoomMinFactor;
-		if (currentProfile->zoomInherit) {
-			zoomMinDist = defaultProfile.zoomMinDistance;
-			zoomMinFactor = defaultProfile.zoomMinFactor;
-		}
-		if (abs((int) currentDist - gestureStartDist) > zoomMinDist && (currentDist / gestureStartDist > zoomMinFactor || currentDist / gestureStartDist < 1/zoomMinFactor)) {
-			amPerformingGesture = GESTURE_ZOOM;
+			emitAction(state, &(profile->scrollBraceAction), EXECUTEACTION_PRESS);
+			state->dragScrolling = profile->scrollBraceAction.actionType != ACTIONTYPE_NONE;
+		} else if (differsBy(currentDistSquared, state->gestureStartDist, profile->zoomMinDistance)
+				&& (currentDistSquared > startDistSquared * zoomMinFactorSquared || currentDistSquared * zoomMinFactorSquared < startDistSquared)) {
+			state->amPerformingGesture = GESTURE_ZOOM;
 			if(inDebugMode()) printf("Start zoom gesture\n");
-			return 1;
-		}
-
-		int rotateMinDist = currentProfile->rotateMinDistance;
-		double rotateMinAngle = currentProfile->rotateMinAngle;
-		if (currentProfile->rotateInherit) {
-			rotateMinDist = defaultProfile.rotateMinDistance;
-			rotateMinAngle = defaultProfile.rotateMinAngle;
-		}
-		double rotatedBy = currentAngle - gestureStartAngle;
-		if (rotatedBy < -180)
-			rotatedBy += 360;
-		if (rotatedBy > 180)
-			rotatedBy -= 360;
-		//printf("Rotated by: %f; min. angle: %f\n", rotatedBy, rotateMinAngle);
-		if (abs(rotatedBy) > rotateMinAngle && (int) currentDist
-				> rotateMinDist) {
-			amPerformingGesture = GESTURE_ROTATE;
+		} else if (isAngleAtLeast(dot, lengthsSquared, profile->rotateMinAngleCos)
+				&& isLongerThan(currentDistSquared, profile->rotateMinDistance)) {
+			state->amPerformingGesture = GESTURE_ROTATE;
 			if(inDebugMode()) printf("Start rotation gesture\n");
-			return 1;
 		}
 	}
 
-	/* If we know what gesture to perform, look if there is something to do */
-	switch (amPerformingGesture) {
+	/* If we know what gesture to perform, perform all steps the fingers have moved by */
+	switch (state->amPerformingGesture) {
 	case GESTURE_SCROLL:
 		;
-		int hscrolledBy = currentCenterX - gestureStartCenterX;
-		int vscrolledBy = currentCenterY - gestureStartCenterY;
-		int hscrollStep = currentProfile->hscrollStep;
-		int vscrollStep = currentProfile->vscrollStep;
-		if (currentProfile->scrollInherit) {
-			hscrollStep = defaultProfile.hscrollStep;
-			vscrollStep = defaultProfile.vscrollStep;
-		}
+		int hscrolledBy = state->currentCenterX - state->gestureStartCenterX;
+		int vscrolledBy = state->currentCenterY - state->gestureStartCenterY;
+		int hscrollStep = state->currentProfile->hscrollStep;
+		int vscrollStep = state->currentProfile->vscrollStep;
 		if (hscrollStep == 0 || vscrollStep == 0)
-			return 0;
-
-		TimeVal currentTime = getCurrentTime();
-		if (hscrolledBy > hscrollStep) {
-			lastScrollDirectionX = 1;
-			lastLastScrollXIntv = lastScrollXIntv;
-			lastScrollXIntv = timeDiff(lastScrollXTime, currentTime);
-			lastScrollXTime = currentTime;
-			if (currentProfile->scrollInherit) {
-				executeAction(&(defaultProfile.scrollRightAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->scrollRightAction),
-						EXECUTEACTION_BOTH);
+			return;
+
+		/* Smooth scrolling for the axes whose actions are plain wheel buttons; the others
+		 * are scrolled step by step below */
+		if (state->smoothScrolling) {
+			Profile* scrollProfile = state->currentProfile;
+			int horizontalX = 0, horizontalY = 0;
+			int signX = smoothScrollDirection(&(scrollProfile->scrollRightAction), &(scrollProfile->scrollLeftAction), &horizontalX);
+			int signY = smoothScrollDirection(&(scrollProfile->scrollDownAction), &(scrollProfile->scrollUpAction), &horizontalY);
+			int wheel[2] = { 0, 0 };
+			if (signX != 0) {
+				wheel[horizontalX ? 0 : 1] += signX * accumulateSmoothScroll(hscrolledBy, hscrollStep, &(state->scrollRemainderX));
+				state->gestureStartCenterX = state->currentCenterX;
+				hscrolledBy = 0;
 			}
-
-			gestureStartCenterX = gestureStartCenterX + hscrollStep;
-			return 1;
-		} else if (hscrolledBy < -hscrollStep) {
-			lastLastScrollXIntv = lastScrollXIntv;
-			lastScrollXIntv = timeDiff(lastScrollXTime, currentTime);
-			lastScrollXTime = currentTime;
-			lastScrollDirectionX = -1;
-			if (currentProfile->scrollInherit) {
-				executeAction(&(defaultProfile.scrollLeftAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->scrollLeftAction),
-						EXECUTEACTION_BOTH);
+			if (signY != 0) {
+				wheel[horizontalY ? 0 : 1] += signY * accumulateSmoothScroll(vscrolledBy, vscrollStep, &(state->scrollRemainderY));
+				state->gestureStartCenterY = state->currentCenterY;
+				vscrolledBy = 0;
 			}
-
-			gestureStartCenterX = gestureStartCenterX - hscrollStep;
-			return 1;
-		}
-		if (vscrolledBy > vscrollStep) {
-			lastLastScrollYIntv = lastScrollYIntv;
-			lastScrollYIntv = timeDiff(lastScrollYTime, currentTime);
-			lastScrollYTime = currentTime;
-			lastScrollDirectionY = 1;
-			if (currentProfile->scrollInherit) {
-				executeAction(&(defaultProfile.scrollDownAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->scrollDownAction),
-						EXECUTEACTION_BOTH);
+			if (wheel[0] != 0 || wheel[1] != 0) {
+				GestureOutput* output = emit(state, GESTUREOUTPUT_SCROLL);
+				output->x = wheel[0];
+				output->y = wheel[1];
 			}
-
-			gestureStartCenterY = gestureStartCenterY + vscrollStep;
-			return 1;
-		} else if (vscrolledBy < -vscrollStep) {
-			lastLastScrollYIntv = lastScrollYIntv;
-			lastScrollYIntv = timeDiff(lastScrollYTime, currentTime);
-			lastScrollYTime = currentTime;
-			lastScrollDirectionY = -1;
-			if (currentProfile->scrollInherit) {
-				executeAction(&(defaultProfile.scrollUpAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->scrollUpAction),
-						EXECUTEACTION_BOTH);
-			}
-
-			gestureStartCenterY = gestureStartCenterY - vscrollStep;
-			return 1;
 		}
 
-		return 0;
+		int hsteps = countSteps(hscrolledBy, hscrollStep);
+		if (hsteps != 0) {
+			emitActions(state, hsteps > 0 ? &(state->currentProfile->scrollRightAction)
+					: &(state->currentProfile->scrollLeftAction), EXECUTEACTION_BOTH, abs(hsteps));
+			state->gestureStartCenterX = state->gestureStartCenterX + hsteps * hscrollStep;
+		}
+		int vsteps = countSteps(vscrolledBy, vscrollStep);
+		if (vsteps != 0) {
+			emitActions(state, vsteps > 0 ? &(state->currentProfile->scrollDownAction)
+					: &(state->currentProfile->scrollUpAction), EXECUTEACTION_BOTH, abs(vsteps));
+			state->gestureStartCenterY = state->gestureStartCenterY + vsteps * vscrollStep;
+		}
+		return;
 	case GESTURE_ZOOM:
 		;
-		double zoomedBy = currentDist / gestureStartDist;
-		double zoomStep = currentProfile->zoomStep;
-		if (currentProfile->zoomInherit)
-			zoomStep = defaultProfile.zoomStep;
-		if (zoomedBy > zoomStep) {
-			if(inDebugMode()) printf("Zoom in step\n");
-			if (currentProfile->zoomInherit) {
-				executeAction(&(defaultProfile.zoomInAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->zoomInAction),
-						EXECUTEACTION_BOTH);
-			}
+		Profile* zoomProfile = state->currentProfile;
+		double zoomStepSquared = zoomProfile->zoomStepSquared;
+		if (currentDistSquared > startDistSquared * zoomStepSquared) {
+			/* The distance has grown by more than zoomStep to the power of steps */
+			int zoomSteps = countZoomSteps(currentDistSquared / startDistSquared, zoomProfile->zoomStepLog);
+			if(inDebugMode()) printf("Zoom in by %i steps\n", zoomSteps);
+			emitActions(state, &(zoomProfile->zoomInAction), EXECUTEACTION_BOTH, zoomSteps);
 			/* Reset distance */
-			gestureStartDist = gestureStartDist * zoomStep;
-			return 1;
-		} else if (zoomedBy < 1 / zoomStep) {
-			if(inDebugMode()) printf("Zoom out step\n");
-			if (currentProfile->zoomInherit) {
-				executeAction(&(defaultProfile.zoomOutAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->zoomOutAction),
-						EXECUTEACTION_BOTH);
-			}
+			state->gestureStartDist = state->gestureStartDist * pow(zoomProfile->zoomStep, zoomSteps);
+		} else if (currentDistSquared * zoomStepSquared < startDistSquared) {
+			int zoomSteps = countZoomSteps(startDistSquared / currentDistSquared, zoomProfile->zoomStepLog);
+			if(inDebugMode()) printf("Zoom out by %i steps\n", zoomSteps);
+			emitActions(state, &(zoomProfile->zoomOutAction), EXECUTEACTION_BOTH, zoomSteps);
 			/* Reset distance */
-			gestureStartDist = gestureStartDist / zoomStep;
-			return 1;
+			state->gestureStartDist = state->gestureStartDist / pow(zoomProfile->zoomStep, zoomSteps);
 		}
-		return 0;
+		return;
 	case GESTURE_ROTATE:
 		;
-		double rotatedBy = currentAngle - gestureStartAngle;
-		if (rotatedBy < -180)
-			rotatedBy += 360;
-		if (rotatedBy > 180)
-			rotatedBy -= 360;
-		double rotateStep = currentProfile->rotateStep;
-		if (currentProfile->rotateInherit)
-			rotateStep = defaultProfile.rotateStep;
-		if (rotatedBy > rotateStep) {
-			if(inDebugMode()) printf("Rotate right\n");
-			if (currentProfile->rotateInherit) {
-				executeAction(&(defaultProfile.rotateRightAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->rotateRightAction),
-						EXECUTEACTION_BOTH);
-			}
+		if (state->currentProfile->rotateStep >= 180)
+			return;
+		double rotateStep = state->currentProfile->rotateStep;
+		double stepCos = state->currentProfile->rotateStepCos;
+		double stepSin = state->currentProfile->rotateStepSin;
+		int rotateSteps;
+		double turnCos, turnSin;
+		if (isTurnedBeyond(startX, startY, xdiff, ydiff, stepCos, stepSin)) {
+			rotateSteps = countRotateSteps(startX, startY, xdiff, ydiff, rotateStep);
+			if(inDebugMode()) printf("Rotate right by %i steps\n", rotateSteps);
+			emitActions(state, &(state->currentProfile->rotateRightAction),
+						EXECUTEACTION_BOTH, rotateSteps);
+
+			turnCos = cos(rotateSteps * rotateStep * PI / 180);
+			turnSin = sin(rotateSteps * rotateStep * PI / 180);
+			state->gestureStartVectorX = startX * turnCos - startY * turnSin;
+			state->gestureStartVectorY = startX * turnSin + startY * turnCos;
+		} else if (isTurnedBeyond(startX, -startY, xdiff, -ydiff, stepCos, stepSin)) {
+			/* The same, mirrored */
+			rotateSteps = countRotateSteps(startX, startY, xdiff, ydiff, rotateStep);
+			if(inDebugMode()) printf("Rotate left by %i steps\n", rotateSteps);
+			emitActions(state, &(state->currentProfile->rotateLeftAction),
+						EXECUTEACTION_BOTH, rotateSteps);
+
+			turnCos = cos(rotateSteps * rotateStep * PI / 180);
+			turnSin = sin(rotateSteps * rotateStep * PI / 180);
+			state->gestureStartVectorX = startX * turnCos + startY * turnSin;
+			state->gestureStartVectorY = startY * turnCos - startX * turnSin;
+		}
+		return;
+	}
+}
 
-			gestureStartAngle = gestureStartAngle + rotateStep;
-		} else if (rotatedBy < -rotateStep) {
-			if(inDebugMode()) printf("Rotate left\n");
-			if (currentProfile->rotateInherit) {
-				executeAction(&(defaultProfile.rotateLeftAction),
-						EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->rotateLeftAction),
-						EXECUTEACTION_BOTH);
+/* Updates the last known positions of the fingers that started the two-finger gesture. */
+static void rememberGestureFingers(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown) {
+	int i, j;
+	for(i = 0; i < fingersDown; i++) {
+		for(j = 0; j < 2; j++) {
+			if(fingerInfos[i].id == state->gestureFingers[j].id) {
+				state->gestureFingers[j] = fingerInfos[i];
 			}
-
-			gestureStartAngle = gestureStartAngle - rotateStep;
 		}
+	}
+}
 
-		return 0;
+/* Calculates the center of all fingers */
+static void getCenter(FingerInfo* fingerInfos, int fingersDown, int* x, int* y) {
+	int i;
+	int sumX = 0, sumY = 0;
+	for(i = 0; i < fingersDown; i++) {
+		sumX += fingerInfos[i].x;
+		sumY += fingerInfos[i].y;
 	}
+	*x = sumX / fingersDown;
+	*y = sumY / fingersDown;
+}
 
-	return 0;
+/* Three or four fingers are (or were) on. A swipe performs its action once, as soon
+ * as the fingers have moved far enough, and then waits for all fingers to be released. */
+static void processSwipe(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown) {
+	Profile* swipeProfile;
 
-}
+	if(fingersDown >= 3 && state->amPerformingGesture != GESTURE_SWIPE) {
+		/* Third finger touched: whatever was going on is over now. */
+		if(state->amPerformingGesture == GESTURE_SCROLL) {
+			emitAction(state, &(state->currentProfile->scrollBraceAction),
+						EXECUTEACTION_RELEASE);
+		}
+		emitRelease(state);
 
-void processFingerGesture(FingerInfo* fingerInfos, int fingersDown, int fingersWereDown, int blockSingleTouches) {
+		state->currentProfile = state->getProfile();
+		state->amPerformingGesture = GESTURE_SWIPE;
+		state->swipeFingers = 0;
+		state->swipePerformed = 0;
+		if(inDebugMode()) printf("Start swipe gesture\n");
+	}
 
-	if(fingersDown != 0 && fingersWereDown == 0) {
-		stopEasing();
+	if(fingersDown == 0) {
+		/* All fingers released, swipe is over */
+		state->amPerformingGesture = GESTURE_NONE;
+		return;
 	}
 
-	TimeVal currentTime = getCurrentTime();
-	if (TWO_FINGERS_DOWN) {
-		/* Second finger touched (and maybe first too) */
+	if(state->swipePerformed) return;
 
-		lastScrollXTime = currentTime;
-		lastScrollYTime = currentTime;
-		lastScrollXIntv = 0; lastScrollYIntv = 0;		
-		lastLastScrollXIntv = 0; lastLastScrollYIntv = 0;		
+	int fingers = fingersDown > 4 ? 4 : fingersDown;
+	if(fingers > state->swipeFingers && fingers >= 3) {
+		/* (Another) finger touched, (re)start with the new number of fingers */
+		state->swipeFingers = fingers;
+		getCenter(fingerInfos, fingersDown, &state->swipeStartCenterX, &state->swipeStartCenterY);
+		return;
+	}
 
-		maxDist = 0;
+	if(fingers < state->swipeFingers) {
+		/* A finger has been released before the swipe was recognized; the center
+		   would jump, so don't perform anything anymore. */
+		state->swipePerformed = 1;
+		return;
+	}
 
-		/* Memorize that there were two fingers on during touch */
-		hadTwoFingersOn = 1;
+	swipeProfile = state->currentProfile;
 
-		/* Get current profile */
-		currentProfile = getWindowProfile(getActiveWindow());
-		if(inDebugMode()) {
-			if(currentProfile->windowClass != NULL) {
-				printf("Use profile '%s'\n", currentProfile->windowClass);
-			} else {
-				printf("Use default profile.\n");
-			}
+	int centerX, centerY;
+	getCenter(fingerInfos, fingersDown, &centerX, &centerY);
+	int xdist = centerX - state->swipeStartCenterX;
+	int ydist = centerY - state->swipeStartCenterY;
+	if(abs(xdist) <= swipeProfile->swipeMinDistance && abs(ydist) <= swipeProfile->swipeMinDistance)
+		return;
+
+	Action* action;
+	if(abs(xdist) > abs(ydist)) {
+		if(state->swipeFingers == 3) {
+			action = xdist > 0 ? &(swipeProfile->swipe3RightAction) : &(swipeProfile->swipe3LeftAction);
+		} else {
+			action = xdist > 0 ? &(swipeProfile->swipe4RightAction) : &(swipeProfile->swipe4LeftAction);
+		}
+	} else {
+		if(state->swipeFingers == 3) {
+			action = ydist > 0 ? &(swipeProfile->swipe3DownAction) : &(swipeProfile->swipe3UpAction);
+		} else {
+			action = ydist > 0 ? &(swipeProfile->swipe4DownAction) : &(swipeProfile->swipe4UpAction);
 		}
+	}
+	if(inDebugMode()) printf("Swipe with %i fingers\n", state->swipeFingers);
+	emitAction(state, action, EXECUTEACTION_BOTH);
+	state->swipePerformed = 1;
+}
 
-		/* If there had already been a single-touch event raised because the
-		 * user was too slow, stop it now. */
-		releaseButton();
+/* Aborts whatever gesture is going on without performing any more actions,
+ * e.g. because touch events have been lost. Like recognizeGesture(), leaves what
+ * has to be done in state->outputs and returns the number of outputs. */
+int cancelFingerGesture(GestureRecognizer* state) {
+	state->outputCount = 0;
+	if(state->amPerformingGesture == GESTURE_SCROLL && state->currentProfile != NULL) {
+		emitAction(state, &(state->currentProfile->scrollBraceAction),
+					EXECUTEACTION_RELEASE);
+	}
+	emitRelease(state);
+	emit(state, GESTUREOUTPUT_STOP_EASING);
+	state->amPerformingGesture = GESTURE_NONE;
+	state->touchState = TOUCH_IDLE;
+	return state->outputCount;
+}
 
-		/* Calculate center position and distance between touch points */
-		gestureStartCenterX = (fingerInfos[0].x + fingerInfos[1].x) / 2;
-		gestureStartCenterY = (fingerInfos[0].y + fingerInfos[1].y) / 2;
+/* First finger touched */
+static void firstFingerDown(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	state->fingerDownTime = currentTime;
 
-		int xdiff = fingerInfos[1].x - fingerInfos[0].x;
-		int ydiff = fingerInfos[1].y - fingerInfos[0].y;
-		gestureStartDist = sqrt(xdiff * xdiff + ydiff * ydiff);
-		gestureStartAngle = atan2(ydiff, xdiff) * 180 / PI;
+	if(!blockSingleTouches) {
+		/* Fake single-touch move event */
+		emitMove(state, fingerInfos[0].x, fingerInfos[0].y, fingerInfos[0].rawZ);
+	}
+}
 
-		/* We have not decided on a gesture yet. */
-		amPerformingGesture = GESTURE_UNDECIDED;
+/* Moved with one finger, no second finger has touched yet */
+static void singleFingerMoved(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	if(!blockSingleTouches) {
+		if (!state->buttonDown && timeDiff(state->fingerDownTime, currentTime) > CLICK_DELAY) {
+			/* Delay has passed, no gesture been performed, so perform single-touch press now */
+			emitPress(state);
+		}
+		if(state->buttonDown) {
+			/* Fake single-touch move event */
+			emitMove(state, fingerInfos[0].x, fingerInfos[0].y, fingerInfos[0].rawZ);
+		}
+	}
+}
+
+/* Last finger released without a second finger having touched */
+static void singleFingerUp(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	if(!blockSingleTouches) {
+		if (!state->buttonDown) {
+			/* The button press time has not been reached yet, and we never had two
+			 * fingers on (we could not have done this in this short time) so
+			 * we simulate button down and up now. */
+			emitPress(state);
+			emitRelease(state);
+		} else {
+			/* We release the button if it is down. */
+			emitRelease(state);
+		}
+	} else if(state->buttonDown) {
+		emitRelease(state);
+	}
+}
 
-		movePointer(gestureStartCenterX, gestureStartCenterY, 0);
-	} else if (TWO_FINGERS_ON) {
+/* Second finger touched (and maybe first too) */
+static void twoFingersDown(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	state->scrollRemainderX = 0; state->scrollRemainderY = 0;
+	state->scrollSampleCount = 0;
+	state->nextScrollSample = 0;
+	state->scrollSampleFingers = 0;
 
-		/* Moved with two fingers */
+	state->maxDistSquared = 0;
 
-		if(fingersDown == 2) {
-			/* Calculate new center between fingers */
-			currentCenterX = (fingerInfos[0].x + fingerInfos[1].x) / 2;
-			currentCenterY = (fingerInfos[0].y + fingerInfos[1].y) / 2;
+	/* Get current profile */
+	state->currentProfile = state->getProfile();
+	if(inDebugMode()) {
+		if(state->currentProfile->windowClass != NULL) {
+			printf("Use profile '%s'\n", state->currentProfile->windowClass);
 		} else {
-			int i;
-			for(i = 0; i <= 1; i++) {
-				if(fingerInfos[i].slotUsed) {
-					currentCenterX = fingerInfos[i].x;
-					currentCenterY = fingerInfos[i].y;
-				}
-			}
+			printf("Use default profile.\n");
 		}
+	}
 
-		/* If we are dragScrolling (we are scrolling and there is a brace action,
-		 * we need to move the pointer */
-		if (amPerformingGesture == GESTURE_SCROLL && dragScrolling) {
-			/* Move pointer to center between touch points */
-			movePointer(currentCenterX, currentCenterY, 0);
-		}
+	/* If there had already been a single-touch event raised because the
+	 * user was too slow, stop it now. */
+	emitRelease(state);
 
-		/* Perform gestures as long as there are some. */
-		while (checkGesture(fingerInfos, fingersDown));
-	} else if (TWO_FINGERS_UP) {
-		/* Second finger (and maybe also first) released */
+	/* Calculate center position and distance between touch points */
+	state->gestureStartCenterX = (fingerInfos[0].x + fingerInfos[1].x) / 2;
+	state->gestureStartCenterY = (fingerInfos[0].y + fingerInfos[1].y) / 2;
 
-		if (amPerformingGesture == GESTURE_SCROLL) {
-			/* If there was a scroll gesture and we have a brace action, perform release. */
-			if (currentProfile->scrollInherit) {
-				executeAction(&(defaultProfile.scrollBraceAction),
-						EXECUTEACTION_RELEASE);
-			} else {
-				executeAction(&(currentProfile->scrollBraceAction),
-						EXECUTEACTION_RELEASE);
-			}
-			if(currentProfile->scrollEasing && isEasingEnabled()) {
-				int intv;
-				int dirX = lastScrollDirectionX;
-				int dirY = lastScrollDirectionY;
-
-				/* Start easing */
-				if(inDebugMode()) printf("Start easing\n");
-
-				/* Compensate for scrolling gestures getting a little bit slower at the end */
-				if(lastLastScrollXIntv < lastScrollXIntv && lastLastScrollXIntv != 0) lastScrollXIntv = lastLastScrollXIntv;
-				if(lastLastScrollYIntv < lastScrollYIntv && lastLastScrollYIntv != 0) lastScrollYIntv = lastLastScrollYIntv;
-
-				/* Check if scrolling intervals are not too long. Also check if last scrolling on an axis is longer
-				   ago than twice its interval, which means the scrolling has been stopped or extremely slowed down since. */
-				if(lastScrollYIntv == 0 || timeDiff(lastScrollYTime, currentTime) > lastScrollYIntv * 2 || lastScrollYIntv > MAX_EASING_START_INTERVAL) dirY = 0;
-				if(lastScrollXIntv == 0 || timeDiff(lastScrollXTime, currentTime) > lastScrollXIntv * 2 || lastScrollXIntv > MAX_EASING_START_INTERVAL) dirX = 0;
-				if(dirX != 0 || dirY != 0) {
-					if(dirX != 0 && dirY != 0) {
-						/* As we only support one interval, only use larger axis. */
-						if(lastScrollXIntv < lastScrollYIntv) {
-							dirY = 0;
-						} else {
-							dirX = 0;
-						}
-					}
-
-					if(dirY == 0) {
-						intv = lastScrollXIntv;
-					} else if(dirX == 0) {
-						intv = lastScrollYIntv;
-					} else {
-						/* We will never reach this, but removes warning */
-						intv = 100000;
-					}
-					if(inDebugMode()) printf("Really start easing\n");
-					startEasing(currentProfile, dirX, dirY, intv);
-				}
-			}
-		}
+	int xdiff = fingerInfos[1].x - fingerInfos[0].x;
+	int ydiff = fingerInfos[1].y - fingerInfos[0].y;
+	state->gestureStartDist = sqrt(xdiff * xdiff + ydiff * ydiff);
+	state->gestureStartVectorX = xdiff;
+	state->gestureStartVectorY = ydiff;
 
-		/* If we haven't performed a gesture and haven't moved too far, perform tap action. */
-		if ((amPerformingGesture == GESTURE_NONE || amPerformingGesture
-				== GESTURE_UNDECIDED) && maxDist < 10) {
-			/* Move pointer to correct position */
-			if(clickMode == 2) {
-				/* Assume first finger is at ID 0 and second finger at ID 1, might have to be changed later */
-				movePointer(gestureStartCenterX, gestureStartCenterY, fingerInfos[0].rawZ);
-			} else {
-				/* Assume first finger is at ID 0 and second finger at ID 1, might have to be changed later */
-				movePointer(fingerInfos[clickMode].x, fingerInfos[clickMode].y, fingerInfos[clickMode].rawZ);
-			}
+	state->gestureFingers[0] = fingerInfos[0];
+	state->gestureFingers[1] = fingerInfos[1];
 
-			if (currentProfile->tapInherit) {
-				executeAction(&(defaultProfile.tapAction), EXECUTEACTION_BOTH);
-			} else {
-				executeAction(&(currentProfile->tapAction), EXECUTEACTION_BOTH);
-			}
-		}
+	/* We have not decided on a gesture yet. */
+	state->amPerformingGesture = GESTURE_UNDECIDED;
 
-		amPerformingGesture = GESTURE_NONE;
+	emitMove(state, state->gestureStartCenterX, state->gestureStartCenterY, 0);
+}
 
-	} else if (fingersDown == 1 && fingersWereDown == 0) {
-		/* First finger touched */
-		fingerDownTime = currentTime;
+/* Moved with two fingers, or with one when continuing the gesture */
+static void twoFingersMoved(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	if(fingersDown == 2) {
+		/* Calculate new center between fingers */
+		state->currentCenterX = (fingerInfos[0].x + fingerInfos[1].x) / 2;
+		state->currentCenterY = (fingerInfos[0].y + fingerInfos[1].y) / 2;
+	} else {
+		state->currentCenterX = fingerInfos[0].x;
+		state->currentCenterY = fingerInfos[0].y;
+	}
 
-		if(!blockSingleTouches) {
-			/* Fake single-touch move event */
-			int i;
-			for(i = 0; i <= 1; i++) {
-				if(fingerInfos[i].slotUsed) {
-					movePointer(fingerInfos[i].x, fingerInfos[i].y, fingerInfos[i].rawZ);
+	rememberGestureFingers(state, fingerInfos, fingersDown);
+
+	/* If we are dragScrolling (we are scrolling and there is a brace action,
+	 * we need to move the pointer */
+	if (state->amPerformingGesture == GESTURE_SCROLL && state->dragScrolling) {
+		/* Move pointer to center between touch points */
+		emitMove(state, state->currentCenterX, state->currentCenterY, 0);
+	}
+
+	checkGesture(state, fingerInfos, fingersDown, currentTime);
+	recordScrollSample(state, fingersDown, currentTime);
+}
+
+/* Second finger (and maybe also first) released */
+static void twoFingersUp(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	if (state->amPerformingGesture == GESTURE_SCROLL) {
+		/* If there was a scroll gesture and we have a brace action, perform release. */
+		emitAction(state, &(state->currentProfile->scrollBraceAction),
+					EXECUTEACTION_RELEASE);
+		if(state->currentProfile->scrollEasing && state->easing) {
+			Profile* profile = state->currentProfile;
+			double speedX, speedY;
+
+			/* Start easing */
+			if(inDebugMode()) printf("Start easing\n");
+
+			if(estimateScrollSpeed(state, currentTime, &speedX, &speedY)) {
+				/* Only keep going on the axes on which a step would take no longer than
+				   MAX_EASING_START_INTERVAL */
+				if(fabs(speedX) * MAX_EASING_START_INTERVAL < profile->hscrollStep * 1000.0) speedX = 0;
+				if(fabs(speedY) * MAX_EASING_START_INTERVAL < profile->vscrollStep * 1000.0) speedY = 0;
+				if(speedX != 0 || speedY != 0) {
+					if(inDebugMode()) printf("Really start easing (%.0f, %.0f pixels per second)\n", speedX, speedY);
+					GestureOutput* output = emit(state, GESTUREOUTPUT_START_EASING);
+					output->profile = profile;
+					output->x = (int) speedX;
+					output->y = (int) speedY;
 				}
 			}
 		}
-	} else if (fingersDown == 1) {
-		/* Moved with one finger */
-		if(!blockSingleTouches) {
-			if (hadTwoFingersOn == 0 && !isButtonDown()) {
-				if (timeDiff(fingerDownTime, currentTime) > CLICK_DELAY) {
-					/* Delay has passed, no gesture been performed, so perform single-touch press now */
-					pressButton();
-				}
-			}
-			if(isButtonDown()) {
-				/* Fake single-touch move event */
-				int i;
-				for(i = 0; i <= 1; i++) {
-					if(fingerInfos[i].slotUsed) {
-						movePointer(fingerInfos[i].x, fingerInfos[i].y, fingerInfos[i].rawZ);
-					}
-				}
+	}
 
-			}
-		}
-	} else if (fingersDown == 0 && fingersWereDown > 0) {
-		/* Last finger released */
-		if(!blockSingleTouches) {
-			if (hadTwoFingersOn == 0 && !isButtonDown()) {
-				/* The button press time has not been reached yet, and we never had two
-				 * fingers on (we could not have done this in this short time) so
-				 * we simulate button down and up now. */
-				pressButton();
-				releaseButton();
-			} else {
-				/* We release the button if it is down. */
-				releaseButton();
-			}
-		}
-		else
-		{
-			if(isButtonDown()) {
-				releaseButton();
-			}
+	/* If we haven't performed a gesture and haven't moved too far, perform tap action. */
+	if ((state->amPerformingGesture == GESTURE_NONE || state->amPerformingGesture
+			== GESTURE_UNDECIDED) && state->maxDistSquared < 100) {
+		/* Move pointer to correct position */
+		if(state->clickMode == 2) {
+			emitMove(state, state->gestureStartCenterX, state->gestureStartCenterY, state->gestureFingers[0].rawZ);
+		} else {
+			emitMove(state, state->gestureFingers[state->clickMode].x, state->gestureFingers[state->clickMode].y, state->gestureFingers[state->clickMode].rawZ);
 		}
+
+		emitAction(state, &(state->currentProfile->tapAction), EXECUTEACTION_BOTH);
 	}
-	if (fingersDown == 0) {
-		/* Reset fields after release */
-		hadTwoFingersOn = 0;
+
+	state->amPerformingGesture = GESTURE_NONE;
+}
+
+/* Moved with the finger that is left after a two-finger gesture */
+static void afterTwoFingersMoved(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	if(!blockSingleTouches && state->buttonDown) {
+		emitMove(state, fingerInfos[0].x, fingerInfos[0].y, fingerInfos[0].rawZ);
+	}
+}
+
+/* Last finger released after a two-finger gesture */
+static void afterTwoFingersUp(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	if(!blockSingleTouches || state->buttonDown) {
+		emitRelease(state);
+	}
+}
+
+/* Three or more fingers are (or were) on */
+static void swipe(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	processSwipe(state, fingerInfos, fingersDown);
+}
+
+/* What happens, depending on the state of the touch and the number of fingers now on.
+ * Without continuation, releasing one of two fingers ends the two-finger gesture, the
+ * remaining finger is ignored until it is released or a second finger touches again. */
+static const GestureTransition continuationTransitions[TOUCH_STATES][FINGER_CLASSES] = {
+	/*                   no fingers                              one finger                                   two fingers                            three or more */
+	/* TOUCH_IDLE */   { { NULL, TOUCH_IDLE },                   { firstFingerDown, TOUCH_SINGLE },           { twoFingersDown, TOUCH_TWO },         { swipe, TOUCH_SWIPE } },
+	/* TOUCH_SINGLE */ { { singleFingerUp, TOUCH_IDLE },         { singleFingerMoved, TOUCH_SINGLE },         { twoFingersDown, TOUCH_TWO },         { swipe, TOUCH_SWIPE } },
+	/* TOUCH_TWO */    { { twoFingersUp, TOUCH_IDLE },           { twoFingersMoved, TOUCH_TWO },              { twoFingersMoved, TOUCH_TWO },        { swipe, TOUCH_SWIPE } },
+	/* TOUCH_AFTER_TWO, not reached */
+	                   { { afterTwoFingersUp, TOUCH_IDLE },      { afterTwoFingersMoved, TOUCH_AFTER_TWO },   { twoFingersDown, TOUCH_TWO },         { swipe, TOUCH_SWIPE } },
+	/* TOUCH_SWIPE */  { { swipe, TOUCH_IDLE },                  { swipe, TOUCH_SWIPE },                      { swipe, TOUCH_SWIPE },                { swipe, TOUCH_SWIPE } }
+};
+
+static const GestureTransition plainTransitions[TOUCH_STATES][FINGER_CLASSES] = {
+	/*                      no fingers                           one finger                                   two fingers                            three or more */
+	/* TOUCH_IDLE */      { { NULL, TOUCH_IDLE },                { firstFingerDown, TOUCH_SINGLE },           { twoFingersDown, TOUCH_TWO },         { swipe, TOUCH_SWIPE } },
+	/* TOUCH_SINGLE */    { { singleFingerUp, TOUCH_IDLE },      { singleFingerMoved, TOUCH_SINGLE },         { twoFingersDown, TOUCH_TWO },         { swipe, TOUCH_SWIPE } },
+	/* TOUCH_TWO */       { { twoFingersUp, TOUCH_IDLE },        { twoFingersUp, TOUCH_AFTER_TWO },           { twoFingersMoved, TOUCH_TWO },        { swipe, TOUCH_SWIPE } },
+	/* TOUCH_AFTER_TWO */ { { afterTwoFingersUp, TOUCH_IDLE },   { afterTwoFingersMoved, TOUCH_AFTER_TWO },   { twoFingersDown, TOUCH_TWO },         { swipe, TOUCH_SWIPE } },
+	/* TOUCH_SWIPE */     { { swipe, TOUCH_IDLE },               { swipe, TOUCH_SWIPE },                      { swipe, TOUCH_SWIPE },                { swipe, TOUCH_SWIPE } }
+};
+
+/* Prepares a recognizer. getProfile is called when a gesture starts, to find out which
+ * profile it uses. */
+void initGestureRecognizer(GestureRecognizer* state, Profile* (*getProfile)(), int clickMode, int continuation) {
+	memset(state, 0, sizeof(GestureRecognizer));
+	state->getProfile = getProfile;
+	state->currentProfile = getDefaultProfile();
+	state->clickMode = clickMode;
+	state->transitions = continuation ? continuationTransitions : plainTransitions;
+	state->touchState = TOUCH_IDLE;
+}
+
+/* Feeds the fingers of a frame to the recognizer. It doesn't perform anything itself:
+ * what has to be done is left in state->outputs. Returns the number of outputs. */
+int recognizeGesture(GestureRecognizer* state, FingerInfo* fingerInfos, int fingersDown, int blockSingleTouches, TimeVal currentTime) {
+	state->outputCount = 0;
+
+	if(fingersDown != 0 && state->touchState == TOUCH_IDLE) {
+		emit(state, GESTUREOUTPUT_STOP_EASING);
+	}
+
+	const GestureTransition* transition = &(state->transitions[state->touchState][fingersDown < FINGER_CLASSES ? fingersDown : FINGER_CLASSES - 1]);
+	if(transition->handler != NULL) {
+		transition->handler(state, fingerInfos, fingersDown, blockSingleTouches, currentTime);
 	}
+	state->touchState = transition->next;
+	return state->outputCount;
 }
 
 
 Profile* getDefaultProfile() {
-	return &defaultProfile;
+	return &(profileSet->defaultProfile);
 }
 
-/* Returns a pointer to the profile of the currently selected
- * window, or defaultProfile if there is no specific profile for it or the window is invalid. */
-Profile* getWindowProfile(Window w) {
-	if (w != None) {
+/* The default profile of profiles.h, which configuration files start from */
+Profile* getBuiltInDefaultProfile() {
+	return &(builtInProfiles.defaultProfile);
+}
 
-		char* class = getWindowClass(w);
+static void compileProfile(Profile* profile) {
+	compileAction(&(profile->scrollDownAction));
+	compileAction(&(profile->scrollUpAction));
+	compileAction(&(profile->scrollLeftAction));
+	compileAction(&(profile->scrollRightAction));
+	compileAction(&(profile->scrollBraceAction));
+	compileAction(&(profile->zoomInAction));
+	compileAction(&(profile->zoomOutAction));
+	compileAction(&(profile->rotateLeftAction));
+	compileAction(&(profile->rotateRightAction));
+	compileAction(&(profile->swipe3UpAction));
+	compileAction(&(profile->swipe3DownAction));
+	compileAction(&(profile->swipe3LeftAction));
+	compileAction(&(profile->swipe3RightAction));
+	compileAction(&(profile->swipe4UpAction));
+	compileAction(&(profile->swipe4DownAction));
+	compileAction(&(profile->swipe4LeftAction));
+	compileAction(&(profile->swipe4RightAction));
+	compileAction(&(profile->tapAction));
+}
 
-		if(class != NULL) {
-			if(inDebugMode()) {
-				printf("Current window: '%s'\n", class);
-			}
+/* (Re)compiles the actions of all profiles for the current output and keyboard mapping */
+void compileProfileActions() {
+	int i;
+	for (i = 0; i < profileSet->profileCount; i++) {
+		compileProfile(&(profileSet->profiles[i]));
+	}
+	compileProfile(&(profileSet->defaultProfile));
+}
 
-			int i;
-			/* Look for the profile with this class */
-			for (i = 0; i < profileCount; i++) {
-				if (!strncmp(class, profiles[i].windowClass, 30)) {
-					free(class);
-					/* Return this profile */
-					return &profiles[i];
-				}
-			}
+/* Returns what we know about the given class, looked up in the profiles and blacklists
+ * the first time it is asked for. NULL for CLASS_NONE. */
+static ClassInfo* resolveClass(int classId) {
+	ClassInfo* info = getClassInfo(classId);
+	if (info != NULL && !info->resolved) {
+		info->profile = lookupClassMap(&(profileSet->profileMap), info->name);
+		if (info->profile == NULL)
+			info->profile = &(profileSet->defaultProfile);
+		info->blacklisted = lookupClassMap(&(profileSet->blacklistMap), info->name) != NULL;
+		info->windowManager = lookupClassMap(&(profileSet->wmBlacklistMap), info->name) != NULL;
+		info->resolved = 1;
+	}
+	return info;
+}
 
-			/* No profile found, return default. */
-			free(class);
-			return &defaultProfile;
-		} else {
-			return &defaultProfile;
+/* Returns the profile for the given window class, or defaultProfile if there is none
+ * or the class is CLASS_NONE. */
+Profile* getClassProfile(int classId) {
+	ClassInfo* info = resolveClass(classId);
+	if (info != NULL) {
+		if(inDebugMode()) {
+			printf("Current window: '%s'\n", info->name);
 		}
+		return info->profile;
+	}
+	return &(profileSet->defaultProfile);
+}
+
+/* Returns a pointer to the profile of the currently selected
+ * window, or defaultProfile if there is no specific profile for it or the window is invalid. */
+Profile* getWindowProfile(Window w) {
+	if (w != None) {
+		return getClassProfile(getWindowClassId(w));
 	} else {
-		return &defaultProfile;
+		return &(profileSet->defaultProfile);
 	}
 }
 
 int isWindowBlacklistedForGestures(Window w) {
-	int i;
-	char* class = getWindowClass(w);
+	ClassInfo* info = resolveClass(getWindowClassId(w));
 
-	if (class != NULL) {
+	if (info != NULL) {
 		if(inDebugMode()) printf("Found window with id %i and class '%s' \n", (int) w,
-					class);
+					info->name);
 
-		for (i = 0; blacklist[i] != NULL; i++) {
-			if (strncmp(class, blacklist[i], 30) == 0) {
-				free(class);
-				return 1;
-			}
+		if (info->blacklisted) {
+			return 1;
 		}
-		
+
 		/* Not blacklisted. Check if is on wmBlacklist */
-		for(i = 0; wmBlacklist[i] != NULL; i++) {
-			if (strncmp(class, wmBlacklist[i], 30) == 0) {
-				free(class);
-				if(inDebugMode()) printf("Look for child\n");
-				return isWindowBlacklisted(getLastChildWindow(w));
-			}
+		if (info->windowManager) {
+			if(inDebugMode()) printf("Look for child\n");
+			return isWindowBlacklisted(getLastChildWindow(w));
 		}
 
-		free(class);
 		return 0;
 	} else {
 		if(inDebugMode()) printf("Found window with id %i and no class.\n", (int) w);
-		//if(inDebugMode()) printf("Look for another child\n");
 		return isWindowBlacklisted(getLastChildWindow(w));
-		return 0;
 	}
 }
@@ -17,13 +17,22 @@
 #ifndef GESTURES_H_
 #define GESTURES_H_
 
-void initGestures(int);
-void processFingerGesture(FingerInfo*, int, int, int);
+void initGestures();
+void initGestureRecognizer(GestureRecognizer*, Profile* (*)(), int, int);
+int recognizeGesture(GestureRecognizer*, FingerInfo*, int, int, TimeVal);
+int cancelFingerGesture(GestureRecognizer*);
 
+Profile *getClassProfile(int);
 Profile *getWindowProfile(Window);
 
 int isWindowBlacklistedForGestures(Window);
 
 Profile * getDefaultProfile();
+Profile * getBuiltInDefaultProfile();
+void compileProfileActions();
+
+/* Needs config.h */
+ProfileSet* setProfileSet(ProfileSet*);
+ProfileSet* getProfileSet();
 
 #endif /* GESTURES_H_ */
@@ -0,0 +1,144 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Event loop: all file descriptors are registered once with epoll, deadlines are
+ * timerfds with absolute expiry times. If no timer is armed, the loop blocks until
+ * one of the file descriptors becomes readable, without any periodic wakeups. */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "loop.h"
+
+#define MAX_LOOP_EVENTS 16
+
+int initEventLoop(EventLoop* loop) {
+	loop->sources = NULL;
+	loop->epollDesc = epoll_create1(EPOLL_CLOEXEC);
+	return loop->epollDesc < 0 ? -1 : 0;
+}
+
+static LoopSource* registerSource(EventLoop* loop, int fileDesc, LoopHandler handler, void* data, int isTimer) {
+	LoopSource* source = malloc(sizeof(LoopSource));
+	if (source == NULL)
+		return NULL;
+
+	source->fileDesc = fileDesc;
+	source->handler = handler;
+	source->data = data;
+	source->isTimer = isTimer;
+	source->removed = 0;
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = source;
+	if (epoll_ctl(loop->epollDesc, EPOLL_CTL_ADD, fileDesc, &event) < 0) {
+		free(source);
+		return NULL;
+	}
+
+	source->next = loop->sources;
+	loop->sources = source;
+	return source;
+}
+
+/* Registers fileDesc; handler is called whenever it is readable. Returns 0 on success. */
+int addLoopSource(EventLoop* loop, int fileDesc, LoopHandler handler, void* data) {
+	return registerSource(loop, fileDesc, handler, data, 0) == NULL ? -1 : 0;
+}
+
+/* Unregisters fileDesc. Does not close it. */
+void removeLoopSource(EventLoop* loop, int fileDesc) {
+	LoopSource* source;
+	for (source = loop->sources; source != NULL; source = source->next) {
+		if (source->fileDesc == fileDesc && !source->removed) {
+			epoll_ctl(loop->epollDesc, EPOLL_CTL_DEL, fileDesc, NULL);
+			source->removed = 1;
+			return;
+		}
+	}
+}
+
+/* Creates a disarmed timer; handler is called once each time its deadline passes.
+ * Returns the timer's file descriptor or -1. */
+int createLoopTimer(EventLoop* loop, LoopHandler handler, void* data) {
+	int timerDesc = timerfd_create(LOOP_TIMER_CLOCK, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerDesc < 0)
+		return -1;
+
+	if (registerSource(loop, timerDesc, handler, data, 1) == NULL) {
+		close(timerDesc);
+		return -1;
+	}
+	return timerDesc;
+}
+
+/* Arms the timer for the given absolute deadline on LOOP_TIMER_CLOCK, or disarms it if deadline is NULL. */
+void setLoopTimer(int timerDesc, struct timeval* deadline) {
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	if (deadline != NULL) {
+		spec.it_value.tv_sec = deadline->tv_sec;
+		spec.it_value.tv_nsec = deadline->tv_usec * 1000;
+		/* An all-zero value would disarm the timer */
+		if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+			spec.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(timerDesc, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+/* Waits until at least one source is ready and calls the handlers of all ready sources.
+ * Returns 0, or -1 on error. */
+int runEventLoop(EventLoop* loop) {
+	struct epoll_event events[MAX_LOOP_EVENTS];
+	int i;
+
+	int count = epoll_wait(loop->epollDesc, events, MAX_LOOP_EVENTS, -1);
+	if (count < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for (i = 0; i < count; i++) {
+		LoopSource* source = events[i].data.ptr;
+		if (source->removed)
+			continue;
+
+		if (source->isTimer) {
+			uint64_t expirations;
+			if (read(source->fileDesc, &expirations, sizeof(expirations)) != sizeof(expirations))
+				continue;
+		}
+		source->handler(source->fileDesc, source->data);
+	}
+
+	/* Free sources removed in the meantime */
+	LoopSource** link = &(loop->sources);
+	while (*link != NULL) {
+		LoopSource* source = *link;
+		if (source->removed) {
+			*link = source->next;
+			free(source);
+		} else {
+			link = &(source->next);
+		}
+	}
+
+	return 0;
+}
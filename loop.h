@@ -0,0 +1,56 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef LOOP_H_
+#define LOOP_H_
+
+#include <sys/time.h>
+#include <time.h>
+
+/* Clock of the loop timers; the same one getCurrentTime() reads and the touch events are stamped with. */
+#define LOOP_TIMER_CLOCK CLOCK_MONOTONIC
+
+typedef struct EventLoop EventLoop;
+typedef struct LoopSource LoopSource;
+
+/* Called when fileDesc is readable (or, for timers, when the deadline has passed) */
+typedef void (*LoopHandler)(int fileDesc, void* data);
+
+struct LoopSource {
+	int fileDesc;
+	LoopHandler handler;
+	void* data;
+	int isTimer;
+	/* Removed while the loop was dispatching, freed afterwards */
+	int removed;
+	LoopSource* next;
+};
+
+struct EventLoop {
+	int epollDesc;
+	LoopSource* sources;
+};
+
+int initEventLoop(EventLoop*);
+int addLoopSource(EventLoop*, int, LoopHandler, void*);
+void removeLoopSource(EventLoop*, int);
+
+int createLoopTimer(EventLoop*, LoopHandler, void*);
+void setLoopTimer(int, struct timeval*);
+
+int runEventLoop(EventLoop*);
+
+#endif /* LOOP_H_ */
@@ -0,0 +1,291 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+#include "twofingemu.h"
+#include "output.h"
+
+static OutputSink* outputSinks[] = { &xtestSink, &nullSink, &countSink, &traceSink, &uinputSink, NULL };
+
+/* Returns the sink with the given name, NULL if there is none */
+OutputSink* findOutputSink(const char* name) {
+	int i;
+	for (i = 0; outputSinks[i] != NULL; i++) {
+		if (strcmp(outputSinks[i]->name, name) == 0)
+			return outputSinks[i];
+	}
+	return NULL;
+}
+
+
+/* XTest sink: fakes the input in the X server. */
+
+static Display* xtestDisplay;
+
+static int xtestOpen(Display* display, const char* argument) {
+	xtestDisplay = display;
+	return display != NULL ? 0 : -1;
+}
+
+static int xtestKeyCode(KeySym keysym) {
+	return XKeysymToKeycode(xtestDisplay, keysym);
+}
+
+static void xtestKey(int code, int press) {
+	XTestFakeKeyEvent(xtestDisplay, code, press ? True : False, CurrentTime);
+}
+
+static void xtestButton(int button, int press) {
+	XTestFakeButtonEvent(xtestDisplay, button, press ? True : False, CurrentTime);
+}
+
+static void xtestMotion(int x, int y, int width, int height) {
+	XTestFakeMotionEvent(xtestDisplay, -1, x, y, CurrentTime);
+}
+
+static void xtestFlush() {
+	XFlush(xtestDisplay);
+}
+
+static void xtestClose() {
+	xtestDisplay = NULL;
+}
+
+OutputSink xtestSink = { "xtest", xtestOpen, xtestKeyCode, xtestKey, xtestButton, xtestMotion, NULL, xtestFlush, xtestClose, 1 };
+
+
+/* Null sink: drops everything, to measure the gesture recognition on its own. */
+
+static int nullOpen(Display* display, const char* argument) {
+	return 0;
+}
+
+/* The sinks below don't deal with key codes and just take the keysyms */
+static int keysymAsCode(KeySym keysym) {
+	return keysym;
+}
+
+static void nullKey(int code, int press) {
+}
+
+static void nullButton(int button, int press) {
+}
+
+static void nullMotion(int x, int y, int width, int height) {
+}
+
+static void nullScroll(int dx, int dy) {
+}
+
+static void nullFlush() {
+}
+
+static void nullClose() {
+}
+
+OutputSink nullSink = { "null", nullOpen, keysymAsCode, nullKey, nullButton, nullMotion, nullScroll, nullFlush, nullClose, 0 };
+
+
+/* Counting sink: counts the actions, and the key, button and pointer events they and the
+ * gestures are made of, and prints statistics when closed. A key with modifiers is one
+ * action, but several key events. */
+
+#define COUNT_MAX_ACTIONS 64
+#define COUNT_MAX_KEYS 64
+#define COUNT_MAX_BUTTONS 16
+
+typedef struct CountedAction CountedAction;
+
+struct CountedAction {
+	int type;
+	int keyButton;
+	int modifier;
+	long presses;
+};
+
+static struct {
+	CountedAction actions[COUNT_MAX_ACTIONS];
+	int actionCount;
+	KeySym keysyms[COUNT_MAX_KEYS];
+	long keyPresses[COUNT_MAX_KEYS];
+	int keyCount;
+	long buttonPresses[COUNT_MAX_BUTTONS];
+	long motions;
+	long scrolls;
+	long scrollUnitsX, scrollUnitsY;
+	long flushes;
+	long releases;
+} counts;
+
+static int countOpen(Display* display, const char* argument) {
+	memset(&counts, 0, sizeof(counts));
+	return 0;
+}
+
+static void countKey(int keysym, int press) {
+	int i;
+	if (!press) {
+		counts.releases++;
+		return;
+	}
+	for (i = 0; i < counts.keyCount; i++) {
+		if (counts.keysyms[i] == keysym)
+			break;
+	}
+	if (i == counts.keyCount) {
+		if (counts.keyCount == COUNT_MAX_KEYS)
+			return;
+		counts.keysyms[counts.keyCount++] = keysym;
+	}
+	counts.keyPresses[i]++;
+}
+
+static void countButton(int button, int press) {
+	if (!press) {
+		counts.releases++;
+	} else if (button >= 0 && button < COUNT_MAX_BUTTONS) {
+		counts.buttonPresses[button]++;
+	}
+}
+
+static void countMotion(int x, int y, int width, int height) {
+	counts.motions++;
+}
+
+static void countScroll(int dx, int dy) {
+	counts.scrolls++;
+	counts.scrollUnitsX += dx;
+	counts.scrollUnitsY += dy;
+}
+
+static void countFlush() {
+	counts.flushes++;
+}
+
+static void countAction(int type, int keyButton, int modifier) {
+	int i;
+	for (i = 0; i < counts.actionCount; i++) {
+		CountedAction* counted = &(counts.actions[i]);
+		if (counted->type == type && counted->keyButton == keyButton && counted->modifier == modifier)
+			break;
+	}
+	if (i == counts.actionCount) {
+		if (counts.actionCount == COUNT_MAX_ACTIONS)
+			return;
+		counts.actions[i].type = type;
+		counts.actions[i].keyButton = keyButton;
+		counts.actions[i].modifier = modifier;
+		counts.actions[i].presses = 0;
+		counts.actionCount++;
+	}
+	counts.actions[i].presses++;
+}
+
+/* Writes an action the way it is written in the configuration file */
+static void describeAction(CountedAction* counted, char* s, int length) {
+	const char* name = XKeysymToString(counted->keyButton);
+	if (counted->type == ACTIONTYPE_BUTTONPRESS)
+		snprintf(s, length, "button %i%s%s%s%s", counted->keyButton,
+				(counted->modifier & MODIFIER_SHIFT) ? " shift" : "",
+				(counted->modifier & MODIFIER_CONTROL) ? " ctrl" : "",
+				(counted->modifier & MODIFIER_ALT) ? " alt" : "",
+				(counted->modifier & MODIFIER_SUPER) ? " super" : "");
+	else
+		snprintf(s, length, "key %s%s%s%s%s", name != NULL ? name : "?",
+				(counted->modifier & MODIFIER_SHIFT) ? " shift" : "",
+				(counted->modifier & MODIFIER_CONTROL) ? " ctrl" : "",
+				(counted->modifier & MODIFIER_ALT) ? " alt" : "",
+				(counted->modifier & MODIFIER_SUPER) ? " super" : "");
+}
+
+static void countClose() {
+	int i;
+	char description[64];
+	printf("Actions:\n");
+	for (i = 0; i < counts.actionCount; i++) {
+		describeAction(&(counts.actions[i]), description, sizeof(description));
+		printf("  %-30s %8li times\n", description, counts.actions[i].presses);
+	}
+	printf("Output events:\n");
+	for (i = 0; i < counts.keyCount; i++) {
+		const char* name = XKeysymToString(counts.keysyms[i]);
+		printf("  key %-16s %8li presses\n", name != NULL ? name : "?", counts.keyPresses[i]);
+	}
+	for (i = 0; i < COUNT_MAX_BUTTONS; i++) {
+		if (counts.buttonPresses[i] > 0)
+			printf("  button %-13i %8li presses\n", i, counts.buttonPresses[i]);
+	}
+	printf("  %-23s %8li\n", "releases", counts.releases);
+	printf("  %-23s %8li\n", "pointer motions", counts.motions);
+	printf("  %-23s %8li\n", "smooth scrolls", counts.scrolls);
+	printf("  %-23s %8li\n", "smooth scroll units x", counts.scrollUnitsX);
+	printf("  %-23s %8li\n", "smooth scroll units y", counts.scrollUnitsY);
+	printf("  %-23s %8li\n", "flushes", counts.flushes);
+}
+
+OutputSink countSink = { "count", countOpen, keysymAsCode, countKey, countButton, countMotion, countScroll, countFlush, countClose, 0, countAction };
+
+
+/* Trace sink: logs every output with its time, to stdout or the file given as argument. */
+
+static FILE* traceFile;
+
+static void traceTime() {
+	TimeVal now = getCurrentTime();
+	fprintf(traceFile, "%li.%06li ", (long) now.tv_sec, (long) now.tv_usec);
+}
+
+static int traceOpen(Display* display, const char* argument) {
+	traceFile = argument != NULL ? fopen(argument, "w") : stdout;
+	return traceFile != NULL ? 0 : -1;
+}
+
+static void traceKey(int keysym, int press) {
+	const char* name = XKeysymToString(keysym);
+	traceTime();
+	fprintf(traceFile, "key %s %s\n", name != NULL ? name : "?", press ? "press" : "release");
+}
+
+static void traceButton(int button, int press) {
+	traceTime();
+	fprintf(traceFile, "button %i %s\n", button, press ? "press" : "release");
+}
+
+static void traceMotion(int x, int y, int width, int height) {
+	traceTime();
+	fprintf(traceFile, "motion %i %i\n", x, y);
+}
+
+static void traceScroll(int dx, int dy) {
+	traceTime();
+	fprintf(traceFile, "scroll %i %i\n", dx, dy);
+}
+
+static void traceFlush() {
+}
+
+static void traceClose() {
+	if (traceFile != stdout)
+		fclose(traceFile);
+	else
+		fflush(stdout);
+	traceFile = NULL;
+}
+
+OutputSink traceSink = { "trace", traceOpen, keysymAsCode, traceKey, traceButton, traceMotion, traceScroll, traceFlush, traceClose, 0 };
@@ -0,0 +1,61 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <X11/Xlib.h>
+
+/* Where the synthesized input goes. A sink is chosen once at startup (--output=NAME[:ARGUMENT]);
+ * all key, button and pointer output of the gesture recognition goes through it. */
+typedef struct OutputSink OutputSink;
+
+/* Units of high-resolution scrolling that make up one wheel click (as for REL_WHEEL_HI_RES) */
+#define SMOOTH_SCROLL_UNITS 120
+
+struct OutputSink {
+	const char* name;
+	/* Prepares the sink; display is NULL while replaying a trace. Returns 0 on success. */
+	int (*open)(Display* display, const char* argument);
+	/* Returns the code key() expects for the given keysym, 0 if there is none. Only called
+	 * when actions are compiled, at startup and when the keyboard mapping changes. */
+	int (*keyCode)(KeySym keysym);
+	void (*key)(int code, int press);
+	void (*button)(int button, int press);
+	/* Moves the pointer to x, y on a screen of width by height pixels */
+	void (*motion)(int x, int y, int width, int height);
+	/* High-resolution scrolling in SMOOTH_SCROLL_UNITS per wheel click; positive is down/right.
+	 * NULL if the sink can only scroll with button clicks. */
+	void (*scroll)(int dx, int dy);
+	/* Called after each group of output that belongs together */
+	void (*flush)();
+	void (*close)();
+	/* Does the sink need an X connection? */
+	int needsDisplay;
+	/* Called when an action is pressed, before the events it is made of (ACTIONTYPE_*,
+	 * keysym or button, MODIFIER_* bits). NULL if the sink only cares about the events. */
+	void (*action)(int type, int keyButton, int modifier);
+};
+
+extern OutputSink xtestSink;
+extern OutputSink nullSink;
+extern OutputSink countSink;
+extern OutputSink traceSink;
+extern OutputSink uinputSink;
+
+OutputSink* findOutputSink(const char*);
+
+#endif /* OUTPUT_H_ */
@@ -0,0 +1,346 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* The threads of the daemon. The main thread runs the event loop, recognizes the gestures
+ * and talks to the X server about windows and devices. Reading the touch devices and
+ * sending the output are done on threads of their own, so that neither a busy main thread
+ * nor a slow X server keep the devices from being drained (and the kernel from dropping
+ * their events). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "pipeline.h"
+#include "ring.h"
+
+/* Frames between the input thread and the main thread */
+#define FRAME_RING_SIZE 256
+/* Output commands between the main thread and the output thread */
+#define COMMAND_RING_SIZE 4096
+
+#define MAX_INPUT_EVENTS 16
+
+
+/* Input thread */
+
+static int inputEpollDesc = -1;
+/* Signaled to stop the input thread */
+static int inputStopDesc = -1;
+static pthread_t inputThread;
+static Ring frameRing;
+static InputFrameHandler frameHandler;
+/* Set by the input thread when it ends */
+static atomic_int inputThreadDone;
+
+/* Copies the frame the decoder of the device has just completed */
+void takeInputFrame(TouchDevice* device, InputFrame* frame) {
+	Decoder* decoder = &(device->decoder);
+	frame->type = INPUTFRAME_FRAME;
+	frame->device = device;
+	frame->time = device->kernelTimestamps ? decoder->frameTime : getCurrentTime();
+	frame->resynced = decoder->resynced;
+	frame->contactCount = decoder->contactCount;
+	memcpy(frame->contacts, decoder->contacts, frame->contactCount * sizeof(FingerInfo));
+}
+
+/* Reads and decodes the available data of a touch device */
+static void readTouchDevice(TouchDevice* device) {
+	struct input_event ev[MAX_READ_EVENTS];
+	InputFrame* frame;
+	int i, consumed;
+
+	int rd = read(device->fileDesc, ev, sizeof(ev));
+	if (rd < (int) sizeof(struct input_event)) {
+		/* Stream stopped, probably because module has been unloaded. The device is
+		   closed on the main thread. */
+		epoll_ctl(inputEpollDesc, EPOLL_CTL_DEL, device->fileDesc, NULL);
+		frame = waitForRingSlot(&frameRing);
+		frame->type = INPUTFRAME_STOPPED;
+		frame->device = device;
+		pushRingSlot(&frameRing);
+		return;
+	}
+	int count = rd / sizeof(struct input_event);
+
+	if (isRecordingTrace()) {
+		/* The events are recorded on the main thread, in order with what it records
+		   while processing their frames. Like frames, they are dropped rather than
+		   waiting for the main thread; the trace then shows the loss. */
+		frame = getRingSlot(&frameRing);
+		if (frame == NULL) {
+			device->eventsDropped = 1;
+		} else {
+			frame->type = INPUTFRAME_EVENTS;
+			frame->device = device;
+			frame->resynced = device->eventsDropped;
+			frame->eventCount = count;
+			memcpy(frame->events, ev, count * sizeof(struct input_event));
+			pushRingSlot(&frameRing);
+			device->eventsDropped = 0;
+		}
+	}
+
+	for (i = 0; i < count; i += consumed) {
+		if (decodeEvents(&(device->decoder), &ev[i], count - i, &consumed) == DECODE_FRAME) {
+			frame = getRingSlot(&frameRing);
+			if (frame == NULL) {
+				/* The main thread is a whole ring behind; rather lose frames than
+				   stop reading. The next frame tells it that some are missing. */
+				device->framesDropped = 1;
+				continue;
+			}
+			takeInputFrame(device, frame);
+			if (device->framesDropped) {
+				frame->resynced = 1;
+				device->framesDropped = 0;
+			}
+			pushRingSlot(&frameRing);
+		}
+	}
+}
+
+static void* runInputThread(void* arg) {
+	struct epoll_event events[MAX_INPUT_EVENTS];
+	int i;
+	for (;;) {
+		int count = epoll_wait(inputEpollDesc, events, MAX_INPUT_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			return NULL;
+		}
+		for (i = 0; i < count; i++) {
+			if (events[i].data.ptr == NULL) {
+				atomic_store(&inputThreadDone, 1);
+				wakeRingConsumer(&frameRing);
+				return NULL;
+			}
+			readTouchDevice((TouchDevice*) events[i].data.ptr);
+		}
+		wakeRingConsumer(&frameRing);
+	}
+}
+
+/* Passes the frames of the input thread to the handler, on the main thread */
+static void handleInputFrames(int fileDesc, void* data) {
+	InputFrame* frame;
+	waitRing(&frameRing);
+	while ((frame = peekRing(&frameRing)) != NULL) {
+		frameHandler(frame);
+		popRing(&frameRing);
+	}
+}
+
+/* Starts the input thread; its frames are passed to handler from the given loop.
+ * Returns 0 on success. */
+int startInputThread(EventLoop* loop, InputFrameHandler handler) {
+	frameHandler = handler;
+	if (initRing(&frameRing, sizeof(InputFrame), FRAME_RING_SIZE) != 0)
+		return -1;
+	if (addLoopSource(loop, frameRing.wakeDesc, handleInputFrames, NULL) != 0)
+		return -1;
+
+	inputEpollDesc = epoll_create1(EPOLL_CLOEXEC);
+	inputStopDesc = eventfd(0, EFD_CLOEXEC);
+	if (inputEpollDesc < 0 || inputStopDesc < 0)
+		return -1;
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if (epoll_ctl(inputEpollDesc, EPOLL_CTL_ADD, inputStopDesc, &event) != 0)
+		return -1;
+
+	return pthread_create(&inputThread, NULL, runInputThread, NULL) == 0 ? 0 : -1;
+}
+
+/* Has the input thread read the device, which must have been opened and have its
+ * decoder set up. Returns 0 on success. */
+int watchTouchDevice(TouchDevice* device) {
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = device;
+	return epoll_ctl(inputEpollDesc, EPOLL_CTL_ADD, device->fileDesc, &event);
+}
+
+/* Stops reading the device; the input thread may still have read a last batch. Only call
+ * it while the input thread doesn't run, or after the stream of the device stopped. */
+void unwatchTouchDevice(TouchDevice* device) {
+	epoll_ctl(inputEpollDesc, EPOLL_CTL_DEL, device->fileDesc, NULL);
+}
+
+/* Stops the input thread and waits for it */
+void stopInputThread() {
+	uint64_t one = 1;
+	if (write(inputStopDesc, &one, sizeof(one)) != sizeof(one))
+		return;
+	/* The input thread may be waiting for room for a message; the frames are thrown
+	   away until it has seen the stop */
+	for (;;) {
+		while (peekRing(&frameRing) != NULL) {
+			popRing(&frameRing);
+		}
+		if (atomic_load(&inputThreadDone))
+			break;
+		waitRing(&frameRing);
+	}
+	pthread_join(inputThread, NULL);
+}
+
+
+/* Output thread */
+
+#define OUTPUTCOMMAND_KEY 0
+#define OUTPUTCOMMAND_BUTTON 1
+#define OUTPUTCOMMAND_MOTION 2
+#define OUTPUTCOMMAND_SCROLL 3
+#define OUTPUTCOMMAND_FLUSH 4
+#define OUTPUTCOMMAND_STOP 5
+#define OUTPUTCOMMAND_ACTION 6
+
+typedef struct OutputCommand OutputCommand;
+
+struct OutputCommand {
+	int type;
+	int a, b, c;
+};
+
+/* The sink the output thread writes to */
+static OutputSink* targetSink;
+/* Stands in for targetSink on the main thread */
+static OutputSink queuedSink;
+static Ring commandRing;
+static pthread_t outputThread;
+
+static void queueCommand(int type, int a, int b, int c) {
+	/* If the output thread is a whole ring behind, wait for it; no output may be lost,
+	   and the devices are still read meanwhile */
+	OutputCommand* command = waitForRingSlot(&commandRing);
+	command->type = type;
+	command->a = a;
+	command->b = b;
+	command->c = c;
+	pushRingSlot(&commandRing);
+}
+
+static void* runOutputThread(void* arg) {
+	OutputCommand* command;
+	for (;;) {
+		while ((command = peekRing(&commandRing)) != NULL) {
+			switch (command->type) {
+			case OUTPUTCOMMAND_KEY:
+				targetSink->key(command->a, command->b);
+				break;
+			case OUTPUTCOMMAND_BUTTON:
+				targetSink->button(command->a, command->b);
+				break;
+			case OUTPUTCOMMAND_MOTION:
+				targetSink->motion(command->a, command->b, command->c >> 16, command->c & 0xffff);
+				break;
+			case OUTPUTCOMMAND_SCROLL:
+				targetSink->scroll(command->a, command->b);
+				break;
+			case OUTPUTCOMMAND_ACTION:
+				targetSink->action(command->a, command->b, command->c);
+				break;
+			case OUTPUTCOMMAND_FLUSH:
+				targetSink->flush();
+				break;
+			case OUTPUTCOMMAND_STOP:
+				popRing(&commandRing);
+				return NULL;
+			}
+			popRing(&commandRing);
+		}
+		waitRing(&commandRing);
+	}
+}
+
+static int queuedOpen(Display* display, const char* argument) {
+	return 0;
+}
+
+/* Key codes are looked up when actions are compiled, on the main thread */
+static int queuedKeyCode(KeySym keysym) {
+	return targetSink->keyCode(keysym);
+}
+
+static void queuedKey(int code, int press) {
+	queueCommand(OUTPUTCOMMAND_KEY, code, press, 0);
+}
+
+static void queuedButton(int button, int press) {
+	queueCommand(OUTPUTCOMMAND_BUTTON, button, press, 0);
+}
+
+/* The screen size is taken along, as it may have changed by the time the output thread
+ * gets to the motion; X screens are at most 32767 pixels wide and high */
+static void queuedMotion(int x, int y, int width, int height) {
+	queueCommand(OUTPUTCOMMAND_MOTION, x, y, (width << 16) | (height & 0xffff));
+}
+
+static void queuedScroll(int dx, int dy) {
+	queueCommand(OUTPUTCOMMAND_SCROLL, dx, dy, 0);
+}
+
+static void queuedAction(int type, int keyButton, int modifier) {
+	queueCommand(OUTPUTCOMMAND_ACTION, type, keyButton, modifier);
+}
+
+/* The output thread only looks at the ring again when a group of output is complete */
+static void queuedFlush() {
+	queueCommand(OUTPUTCOMMAND_FLUSH, 0, 0, 0);
+	wakeRingConsumer(&commandRing);
+}
+
+/* Lets the output thread send what is queued, then closes the sink */
+static void queuedClose() {
+	queueCommand(OUTPUTCOMMAND_STOP, 0, 0, 0);
+	wakeRingConsumer(&commandRing);
+	pthread_join(outputThread, NULL);
+	freeRing(&commandRing);
+	targetSink->close();
+}
+
+/* Starts the output thread for the given sink, which has been opened already. Returns
+ * the sink to use on the main thread instead, NULL if the thread couldn't be started. */
+OutputSink* startOutputThread(OutputSink* sink) {
+	if (initRing(&commandRing, sizeof(OutputCommand), COMMAND_RING_SIZE) != 0)
+		return NULL;
+	targetSink = sink;
+	queuedSink = *sink;
+	queuedSink.open = queuedOpen;
+	queuedSink.keyCode = queuedKeyCode;
+	queuedSink.key = queuedKey;
+	queuedSink.button = queuedButton;
+	queuedSink.motion = queuedMotion;
+	queuedSink.scroll = sink->scroll != NULL ? queuedScroll : NULL;
+	queuedSink.flush = queuedFlush;
+	queuedSink.close = queuedClose;
+	queuedSink.action = sink->action != NULL ? queuedAction : NULL;
+	if (pthread_create(&outputThread, NULL, runOutputThread, NULL) != 0) {
+		freeRing(&commandRing);
+		return NULL;
+	}
+	return &queuedSink;
+}
@@ -0,0 +1,41 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <X11/Xlib.h>
+#include "twofingemu.h"
+#include "output.h"
+#include "loop.h"
+
+/* Frames per device are read and decoded on the input thread, recognized on the main
+ * thread (which also keeps track of the windows), and their output goes to the sink on
+ * the output thread. The threads are connected by rings. */
+
+/* Handles the frames of the input thread on the main thread */
+typedef void (*InputFrameHandler)(InputFrame*);
+
+void takeInputFrame(TouchDevice*, InputFrame*);
+
+int startInputThread(EventLoop*, InputFrameHandler);
+int watchTouchDevice(TouchDevice*);
+void unwatchTouchDevice(TouchDevice*);
+void stopInputThread();
+
+OutputSink* startOutputThread(OutputSink*);
+
+#endif /* PIPELINE_H_ */
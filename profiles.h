@@ -40,6 +40,7 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollRightAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollEasing = 0,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 0,
 					.zoomMinDistance = 80,
 					.zoomInAction = { ACTIONTYPE_BUTTONPRESS, 4, MODIFIER_CONTROL },
@@ -52,6 +53,7 @@ Profile profiles[] = {
 					.rotateStep = 70,
 					.rotateLeftAction = { ACTIONTYPE_KEYPRESS, XK_Left, MODIFIER_CONTROL },
 					.rotateRightAction = { ACTIONTYPE_KEYPRESS, XK_Right, MODIFIER_CONTROL },
+					.swipeInherit = 1,
 					.tapInherit = 1
 				},
 				{ 	.windowClass = "eog",
@@ -65,6 +67,7 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollRightAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollEasing = 0,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 0,
 					.zoomMinDistance = 80,
 					.zoomInAction = { ACTIONTYPE_BUTTONPRESS, 4, 0 },
@@ -77,6 +80,7 @@ Profile profiles[] = {
 					.rotateStep = 70,
 					.rotateLeftAction = { ACTIONTYPE_KEYPRESS, XK_R, MODIFIER_CONTROL | MODIFIER_SHIFT },
 					.rotateRightAction = { ACTIONTYPE_KEYPRESS, XK_R, MODIFIER_CONTROL },
+					.swipeInherit = 1,
 					.tapInherit = 1
 					//,
 					//.tapAction = {ACTIONTYPE_NONE,0,0 }
@@ -92,6 +96,7 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_BUTTONPRESS, 7, MODIFIER_SHIFT },
 					.scrollRightAction = { ACTIONTYPE_BUTTONPRESS, 6, MODIFIER_SHIFT },
 					.scrollEasing = 1,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 0,
 					.zoomMinDistance = 80,
 					.zoomInAction = { ACTIONTYPE_BUTTONPRESS, 4, 0 },
@@ -104,6 +109,7 @@ Profile profiles[] = {
 					.rotateStep = 70,
 					.rotateLeftAction = { ACTIONTYPE_KEYPRESS, XK_bracketleft, 0 },
 					.rotateRightAction = { ACTIONTYPE_KEYPRESS, XK_bracketright, 0 },
+					.swipeInherit = 1,
 					.tapInherit = 1
 				},
 				{ 	.windowClass = "netbook-launcher",
@@ -117,8 +123,10 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_KEYPRESS,XK_Right, MODIFIER_CONTROL | MODIFIER_ALT },
 					.scrollRightAction = { ACTIONTYPE_KEYPRESS,XK_Left, MODIFIER_CONTROL | MODIFIER_ALT },
 					.scrollEasing = 0,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 1,
 					.rotateInherit = 1,
+					.swipeInherit = 1,
 					.tapInherit = 1
 				},
 				{ 	.windowClass = "desktop_window",
@@ -132,8 +140,10 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_KEYPRESS,XK_Right, MODIFIER_CONTROL | MODIFIER_ALT },
 					.scrollRightAction = { ACTIONTYPE_KEYPRESS,XK_Left, MODIFIER_CONTROL | MODIFIER_ALT },
 					.scrollEasing = 0,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 1,
 					.rotateInherit = 1,
+					.swipeInherit = 1,
 					.tapInherit = 1
 				},
 				{ 	.windowClass = "acroread",
@@ -147,6 +157,7 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_BUTTONPRESS, 5, MODIFIER_SHIFT },
 					.scrollRightAction = { ACTIONTYPE_BUTTONPRESS, 4, MODIFIER_SHIFT },
 					.scrollEasing = 1,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 0,
 					.zoomMinDistance = 80,
 					.zoomInAction = { ACTIONTYPE_KEYPRESS, XK_equal, MODIFIER_CONTROL },
@@ -159,6 +170,7 @@ Profile profiles[] = {
 					.rotateStep = 70,
 					.rotateLeftAction = { ACTIONTYPE_KEYPRESS, XK_Left, MODIFIER_CONTROL },
 					.rotateRightAction = { ACTIONTYPE_KEYPRESS, XK_Right, MODIFIER_CONTROL },
+					.swipeInherit = 1,
 					.tapInherit = 1
 				},
 			 	{	.windowClass = "SimCity 4.exe",
@@ -172,6 +184,7 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollRightAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollEasing = 0,
+					.scrollEasingDecay = 500,
 //					.scrollMinDistance = 20,
 //					.hscrollStep = 10,
 //					.vscrollStep = 10,
@@ -187,6 +200,7 @@ Profile profiles[] = {
 					.zoomStep = 1.5,
 					.zoomMinFactor = 1.5,
 					.rotateInherit = 1,
+					.swipeInherit = 1,
 					.tapInherit = 1
 				},
 				{	.windowClass = "googleearth-bin",
@@ -200,6 +214,7 @@ Profile profiles[] = {
 					.scrollLeftAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollRightAction = { ACTIONTYPE_NONE,0,0 },
 					.scrollEasing = 0,
+					.scrollEasingDecay = 500,
 					.zoomInherit = 0,
 					.zoomMinDistance = 80,
 					.zoomInAction = { ACTIONTYPE_BUTTONPRESS, 4, 0 },
@@ -212,6 +227,7 @@ Profile profiles[] = {
 					.rotateStep = 15,
 					.rotateLeftAction = { ACTIONTYPE_BUTTONPRESS, 5, MODIFIER_CONTROL },
 					.rotateRightAction = { ACTIONTYPE_BUTTONPRESS, 4, MODIFIER_CONTROL },
+					.swipeInherit = 1,
 					.tapInherit = 1
 					//,
 					//.tapAction = {ACTIONTYPE_NONE,0,0 }
@@ -232,6 +248,7 @@ Profile defaultProfile = {	.windowClass = NULL,
 				.scrollLeftAction = { ACTIONTYPE_BUTTONPRESS, 7, 0 },
 				.scrollRightAction = { ACTIONTYPE_BUTTONPRESS, 6, 0 },
 				.scrollEasing = 1,
+				.scrollEasingDecay = 500,
 				.zoomInherit = 0,
 				.zoomMinDistance = 80,
 				.zoomInAction = { ACTIONTYPE_BUTTONPRESS, 4, MODIFIER_CONTROL },
@@ -244,6 +261,16 @@ Profile defaultProfile = {	.windowClass = NULL,
 				.rotateLeftAction = { ACTIONTYPE_NONE,0,0 },
 				.rotateRightAction = { ACTIONTYPE_NONE,0,0 },
 				.rotateStep = 90,
+				.swipeInherit = 0,
+				.swipeMinDistance = 100,
+				.swipe3UpAction = { ACTIONTYPE_NONE,0,0 },
+				.swipe3DownAction = { ACTIONTYPE_NONE,0,0 },
+				.swipe3LeftAction = { ACTIONTYPE_KEYPRESS, XK_Right, MODIFIER_ALT },
+				.swipe3RightAction = { ACTIONTYPE_KEYPRESS, XK_Left, MODIFIER_ALT },
+				.swipe4UpAction = { ACTIONTYPE_NONE,0,0 },
+				.swipe4DownAction = { ACTIONTYPE_NONE,0,0 },
+				.swipe4LeftAction = { ACTIONTYPE_KEYPRESS, XK_Right, MODIFIER_CONTROL | MODIFIER_ALT },
+				.swipe4RightAction = { ACTIONTYPE_KEYPRESS, XK_Left, MODIFIER_CONTROL | MODIFIER_ALT },
 				.tapInherit = 0,
 				.tapAction = { ACTIONTYPE_BUTTONPRESS, 3, 0	}
 			  };
@@ -0,0 +1,127 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "ring.h"
+
+/* Sets up a ring of capacity elements of elementSize bytes; capacity must be a power of
+ * two. Returns 0 on success. */
+int initRing(Ring* ring, size_t elementSize, unsigned int capacity) {
+	ring->elements = malloc(elementSize * capacity);
+	if (ring->elements == NULL)
+		return -1;
+	ring->wakeDesc = eventfd(0, EFD_CLOEXEC);
+	ring->spaceDesc = eventfd(0, EFD_CLOEXEC);
+	if (ring->wakeDesc < 0 || ring->spaceDesc < 0) {
+		if (ring->wakeDesc >= 0)
+			close(ring->wakeDesc);
+		if (ring->spaceDesc >= 0)
+			close(ring->spaceDesc);
+		free(ring->elements);
+		ring->elements = NULL;
+		return -1;
+	}
+	ring->elementSize = elementSize;
+	ring->mask = capacity - 1;
+	atomic_init(&(ring->head), 0);
+	atomic_init(&(ring->tail), 0);
+	atomic_init(&(ring->producerWaiting), 0);
+	return 0;
+}
+
+void freeRing(Ring* ring) {
+	free(ring->elements);
+	ring->elements = NULL;
+	close(ring->wakeDesc);
+	close(ring->spaceDesc);
+}
+
+/* Returns the slot to fill in next, NULL if the ring is full. The element becomes
+ * visible to the consumer with pushRingSlot(). */
+void* getRingSlot(Ring* ring) {
+	unsigned int tail = atomic_load_explicit(&(ring->tail), memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&(ring->head), memory_order_acquire);
+	if (tail - head > ring->mask)
+		return NULL;
+	return ring->elements + (tail & ring->mask) * ring->elementSize;
+}
+
+void pushRingSlot(Ring* ring) {
+	unsigned int tail = atomic_load_explicit(&(ring->tail), memory_order_relaxed);
+	atomic_store_explicit(&(ring->tail), tail + 1, memory_order_release);
+}
+
+/* Wakes the consumer if it waits in waitRing() (or watches wakeDesc); call it after
+ * pushing, as the consumer only checks the ring again when woken. */
+void wakeRingConsumer(Ring* ring) {
+	uint64_t one = 1;
+	ssize_t written = write(ring->wakeDesc, &one, sizeof(one));
+	(void) written;
+}
+
+/* Like getRingSlot(), but blocks until the consumer has made room if the ring is full.
+ * Wakes the consumer first, as it may be waiting for what has been pushed so far. */
+void* waitForRingSlot(Ring* ring) {
+	void* slot;
+	while ((slot = getRingSlot(ring)) == NULL) {
+		wakeRingConsumer(ring);
+		atomic_store(&(ring->producerWaiting), 1);
+		/* Checked again after announcing the wait, so that a pop in between is not
+		   missed: either it sees the flag, or this sees its head. */
+		atomic_thread_fence(memory_order_seq_cst);
+		if ((slot = getRingSlot(ring)) != NULL) {
+			atomic_store(&(ring->producerWaiting), 0);
+			break;
+		}
+		uint64_t count;
+		ssize_t got = read(ring->spaceDesc, &count, sizeof(count));
+		(void) got;
+	}
+	return slot;
+}
+
+/* Returns the oldest element, NULL if the ring is empty. It stays valid until popRing(). */
+void* peekRing(Ring* ring) {
+	unsigned int head = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&(ring->tail), memory_order_acquire);
+	if (head == tail)
+		return NULL;
+	return ring->elements + (head & ring->mask) * ring->elementSize;
+}
+
+void popRing(Ring* ring) {
+	unsigned int head = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+	atomic_store_explicit(&(ring->head), head + 1, memory_order_release);
+
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&(ring->producerWaiting), memory_order_relaxed)
+			&& atomic_exchange(&(ring->producerWaiting), 0)) {
+		uint64_t one = 1;
+		ssize_t written = write(ring->spaceDesc, &one, sizeof(one));
+		(void) written;
+	}
+}
+
+/* Blocks until the producer has called wakeRingConsumer() since the last wait. Also
+ * clears wakeDesc once it is readable when it is watched by an event loop instead. */
+void waitRing(Ring* ring) {
+	uint64_t count;
+	ssize_t got = read(ring->wakeDesc, &count, sizeof(count));
+	(void) got;
+}
@@ -0,0 +1,59 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* Bounded queue between exactly one producer thread and one consumer thread. Neither
+ * side takes a lock: each index is only written by its own side, and the other side
+ * reads it with acquire semantics. A consumer that has run out of elements waits on
+ * wakeDesc, an eventfd the producer signals; a producer that must not drop an element
+ * while the ring is full waits on spaceDesc, which the consumer signals. */
+typedef struct Ring Ring;
+
+struct Ring {
+	char* elements;
+	size_t elementSize;
+	/* Capacity - 1; the capacity is a power of two */
+	unsigned int mask;
+	/* Next element to read, written by the consumer only */
+	_Alignas(64) atomic_uint head;
+	/* Next element to write, written by the producer only */
+	_Alignas(64) atomic_uint tail;
+	/* Set while the producer waits for space */
+	atomic_int producerWaiting;
+	int wakeDesc;
+	int spaceDesc;
+};
+
+int initRing(Ring*, size_t, unsigned int);
+void freeRing(Ring*);
+
+/* Producer side */
+void* getRingSlot(Ring*);
+void pushRingSlot(Ring*);
+void wakeRingConsumer(Ring*);
+void* waitForRingSlot(Ring*);
+
+/* Consumer side */
+void* peekRing(Ring*);
+void popRing(Ring*);
+void waitRing(Ring*);
+
+#endif /* RING_H_ */
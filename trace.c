@@ -0,0 +1,147 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Binary traces of everything the gesture recognition depends on: the raw events of the
+ * touch devices and the few things we learn from X. A trace can be replayed through the
+ * same code on the clock of the trace, see replayTrace(). */
+
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+#define MAGIC_LENGTH (sizeof(TRACE_MAGIC) - 1)
+
+/* Returns 0 on success, -1 otherwise (errno is set). */
+int openTraceForWriting(Trace* trace, const char* fileName) {
+	trace->file = fopen(fileName, "wb");
+	if (trace->file == NULL)
+		return -1;
+	if (fwrite(TRACE_MAGIC, MAGIC_LENGTH, 1, trace->file) != 1) {
+		fclose(trace->file);
+		trace->file = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/* Returns 0 on success, -1 if the file can't be opened or is no trace. */
+int openTraceForReading(Trace* trace, const char* fileName) {
+	char magic[MAGIC_LENGTH];
+	trace->file = fopen(fileName, "rb");
+	if (trace->file == NULL)
+		return -1;
+	if (fread(magic, MAGIC_LENGTH, 1, trace->file) != 1 || memcmp(magic, TRACE_MAGIC, MAGIC_LENGTH) != 0) {
+		fclose(trace->file);
+		trace->file = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+void closeTrace(Trace* trace) {
+	if (trace->file != NULL) {
+		fclose(trace->file);
+		trace->file = NULL;
+	}
+}
+
+/* Writes buffered records to the file */
+void flushTrace(Trace* trace) {
+	if (trace->file != NULL)
+		fflush(trace->file);
+}
+
+void writeTraceRecord(Trace* trace, int type, int device, struct timeval time, const void* data, int length) {
+	TraceRecordHeader header;
+	if (trace->file == NULL)
+		return;
+	if (length > TRACE_MAX_PAYLOAD)
+		length = TRACE_MAX_PAYLOAD;
+
+	memset(&header, 0, sizeof(header));
+	header.type = type;
+	header.device = device;
+	header.length = length;
+	header.sec = time.tv_sec;
+	header.usec = time.tv_usec;
+	fwrite(&header, sizeof(header), 1, trace->file);
+	if (length > 0)
+		fwrite(data, length, 1, trace->file);
+}
+
+/* Reads the next record. Returns 1 on success, 0 at the end of the trace and -1 if
+ * the trace is truncated. */
+int readTraceRecord(Trace* trace, TraceRecord* record) {
+	TraceRecordHeader header;
+	if (fread(&header, sizeof(header), 1, trace->file) != 1)
+		return feof(trace->file) ? 0 : -1;
+
+	record->type = header.type;
+	record->device = header.device;
+	record->length = header.length;
+	record->time.tv_sec = header.sec;
+	record->time.tv_usec = header.usec;
+	if (record->length > 0 && fread(record->data, record->length, 1, trace->file) != 1)
+		return -1;
+	record->data[record->length] = '\0';
+	return 1;
+}
+
+/* Returns the type of the next record without reading it, or -1 at the end of the trace */
+int peekTraceRecordType(Trace* trace) {
+	TraceRecordHeader header;
+	long position = ftell(trace->file);
+	if (fread(&header, sizeof(header), 1, trace->file) != 1) {
+		clearerr(trace->file);
+		fseek(trace->file, position, SEEK_SET);
+		return -1;
+	}
+	fseek(trace->file, position, SEEK_SET);
+	return header.type;
+}
+
+/* Converts count events; out must have room for count TraceEvents.
+ * Returns the size of the payload. */
+int encodeTraceEvents(const struct input_event* ev, int count, TraceEvent* out) {
+	int i;
+	for (i = 0; i < count; i++) {
+		out[i].sec = ev[i].input_event_sec;
+		out[i].usec = ev[i].input_event_usec;
+		out[i].type = ev[i].type;
+		out[i].code = ev[i].code;
+		out[i].value = ev[i].value;
+	}
+	return count * sizeof(TraceEvent);
+}
+
+/* Converts the events of a TRACE_EVENTS record, at most maxCount of them.
+ * Returns the number of events. */
+int decodeTraceEvents(const TraceRecord* record, struct input_event* ev, int maxCount) {
+	const TraceEvent* in = (const TraceEvent*) record->data;
+	int count = record->length / sizeof(TraceEvent);
+	int i;
+	if (count > maxCount)
+		count = maxCount;
+	for (i = 0; i < count; i++) {
+		memset(&(ev[i]), 0, sizeof(struct input_event));
+		ev[i].input_event_sec = in[i].sec;
+		ev[i].input_event_usec = in[i].usec;
+		ev[i].type = in[i].type;
+		ev[i].code = in[i].code;
+		ev[i].value = in[i].value;
+	}
+	return count;
+}
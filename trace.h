@@ -0,0 +1,115 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <linux/input.h>
+
+/* A trace is the magic followed by records. Each record is a TraceRecordHeader and
+ * length bytes of payload. All numbers are stored in host byte order. */
+#define TRACE_MAGIC "TWOFTRC1"
+
+/* Record types */
+/* Events read from a device; payload: TraceEvent[] */
+#define TRACE_EVENTS 1
+/* A device has been opened; payload: TraceDevice, followed by the device name */
+#define TRACE_DEVICE_OPENED 2
+#define TRACE_DEVICE_CLOSED 3
+/* Calibration of a device has been read; payload: TraceCalibration */
+#define TRACE_CALIBRATION 4
+/* Screen size; payload: two int32_t */
+#define TRACE_SCREEN_SIZE 5
+/* Active window has been looked up; payload: one of the TRACE_WINDOW_* values,
+ * followed by the window class for TRACE_WINDOW_CLASS */
+#define TRACE_ACTIVE_WINDOW 6
+/* Input from the blocking device; no payload */
+#define TRACE_BLOCKING_INPUT 7
+
+#define TRACE_WINDOW_NONE 0
+#define TRACE_WINDOW_NO_CLASS 1
+#define TRACE_WINDOW_CLASS 2
+
+#define TRACE_MAX_PAYLOAD 65535
+
+typedef struct TraceRecordHeader TraceRecordHeader;
+typedef struct TraceEvent TraceEvent;
+typedef struct TraceDevice TraceDevice;
+typedef struct TraceCalibration TraceCalibration;
+typedef struct TraceRecord TraceRecord;
+typedef struct Trace Trace;
+
+struct TraceRecordHeader {
+	uint8_t type;
+	/* Index of the touch device the record belongs to */
+	uint8_t device;
+	uint16_t length;
+	/* Time of the record on CLOCK_MONOTONIC */
+	int32_t sec;
+	int32_t usec;
+};
+
+/* struct input_event without the architecture-dependent sizes */
+struct TraceEvent {
+	int32_t sec;
+	int32_t usec;
+	uint16_t type;
+	uint16_t code;
+	int32_t value;
+};
+
+struct TraceDevice {
+	int32_t slotCount;
+	int32_t useLegacyProtocol;
+	int32_t kernelTimestamps;
+};
+
+struct TraceCalibration {
+	int32_t minX, maxX, minY, maxY;
+	uint8_t swapX, swapY, swapAxes, matrixUse;
+	float matrix[6];
+};
+
+/* A record as read from a trace */
+struct TraceRecord {
+	int type;
+	int device;
+	struct timeval time;
+	int length;
+	/* One extra byte so that string payloads can be terminated */
+	unsigned char data[TRACE_MAX_PAYLOAD + 1];
+};
+
+struct Trace {
+	FILE* file;
+};
+
+int openTraceForWriting(Trace*, const char*);
+int openTraceForReading(Trace*, const char*);
+void closeTrace(Trace*);
+void flushTrace(Trace*);
+
+void writeTraceRecord(Trace*, int, int, struct timeval, const void*, int);
+int readTraceRecord(Trace*, TraceRecord*);
+int peekTraceRecordType(Trace*);
+
+int encodeTraceEvents(const struct input_event*, int, TraceEvent*);
+int decodeTraceEvents(const TraceRecord*, struct input_event*, int);
+
+#endif /* TRACE_H_ */
@@ -27,12 +27,20 @@
 #include <X11/extensions/XInput2.h>
 #include <X11/extensions/Xrandr.h>
 #include "twofingemu.h"
+#include "classes.h"
+#include "config.h"
 #include "gestures.h"
 #include "easing.h"
 #include "devices.h"
+#include "loop.h"
+#include "trace.h"
+#include "output.h"
+#include "windows.h"
+#include "pipeline.h"
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/select.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
 #include <time.h>
 #include <signal.h>
 #include <pthread.h>
@@ -89,47 +97,50 @@ static void daemonize(void) {
 	r = r;
 }
 
-/* Finger information */
-FingerInfo fingerInfos[2] = { { .rawX=0, .rawY=0, .rawZ=0, .id = -1, .slotUsed = 0, .setThisTime = 0 }, { .rawX=0, .rawY=0, .rawZ=0,
-		.id = -1, .slotUsed = 0, .setThisTime = 0 } };
+/* The touch devices we read from */
+TouchDevice touchDevices[MAX_TOUCH_DEVICES];
+int touchDeviceCount = 0;
 
 /* X stuff */
 Display* display;
+/* Connection of the output, display unless the output needs one of its own */
+Display* outputDisplay;
 Window root;
 int screenNum;
-int deviceID;
-int calibrateDeviceID;
 Atom WM_CLASS;
-pthread_t xLoopThread;
+Atom NET_ACTIVE_WINDOW;
 int randrEvBase;
 int randrErrBase;
 int xinputEvBase;
 int xinputErrBase;
 int disableOnGrab = 0;
 
-/* Calibration data */
-int calibMinX, calibMaxX, calibMinY, calibMaxY;
-unsigned char calibSwapX, calibSwapY, calibSwapAxes;
-float calibMatrix[6];
-int calibMatrixUse = 0;
-
 /* The width and height of the screen in pixels */
 unsigned int screenWidth, screenHeight;
 
-/* Finger data */
-int fingersDown = 0;
-int fingersWereDown = 0;
-/* Has button press of first button been called in XTest? */
+/* The active top-level window, its class and profile, kept up to date while
+ * activeWindowTracked (i.e. the window manager sets _NET_ACTIVE_WINDOW) */
+Window activeWindow = None;
+int activeClassId = CLASS_NONE;
+Profile* activeProfile = NULL;
+int activeWindowTracked = 0;
+
+/* Where key, button and pointer output goes */
+OutputSink* output = &xtestSink;
+/* Where taps are performed: 0 - first finger; 1 - second finger; 2 - center */
+int clickMode = 2;
+/* Has button press of first button been sent to the output? */
 int buttonDown = 0;
-
-/* Does the device use the legacy MT protocol? */
-int useLegacyProtocol = 0;
+/* Scroll in high resolution where the output supports it (--smooth-scroll) */
+int smoothScrolling = 0;
+/* Filter for the devices given after --filter or --predict, also used for replayed ones */
+FilterSettings filterSettings = { 0, 1.0, 0.007, 1.0, 0 };
 
 /* Blocking Device */
+char* blockingDevName = 0;
 int blockingDeviceID = -1;
 int blockingIntervalMilliseconds = BLOCKING_INTERVAL_MS_DEFAULT;
 TimeVal lastBlockingInputTime = { 0, 0};
-int currentTouchBlocked = 0;
 int alsoBlockTwoFingerTouches = 0;
 
 /* Ability to move mouse back after touches */
@@ -138,17 +149,44 @@ int prevMouseX = 0;
 int prevMouseY = 0;
 
 /* Signal handling */
-pthread_t signalThread;
 sigset_t signalSet;
 
 int stopSignalReceived = 0;
 
+/* Event loop */
+EventLoop eventLoop;
+int easingTimerDesc = -1;
+/* Deadline the easing timer is armed for, if easingTimerArmed */
+TimeVal easingTimerDeadline;
+int easingTimerArmed = 0;
+/* inotify instance watching the directories of the device files */
+int hotplugDesc = -1;
+
+/* Passthrough: while a blacklisted window is active, the devices are not grabbed, so
+ * that the window gets the touches directly, and twofing ignores them. */
+int passthrough = 0;
+/* Timer for switching passthrough on or off once the focus has settled */
+int passthroughTimerDesc = -1;
+
+/* Configuration file (--config, or found in the usual places) and its cache */
+char* configFile = NULL;
+char* configCacheFile = NULL;
+/* Watch of the directory of the configuration file, and the file's name in it */
+int configWatchDesc = -1;
+char* configFileName = NULL;
+/* Profile sets that have been replaced by a reload while they could still be in use */
+ProfileSet* retiredProfiles = NULL;
+
+/* Trace being recorded (--record) or replayed (--replay) */
+Trace trace;
+int recording = 0;
+int replaying = 0;
+/* Time on the clock of the trace while replaying */
+TimeVal replayTime;
+/* Class of the active window while replaying, NULL if it has none */
+char* replayWindowClass = NULL;
 
 
-/* Handle errors by, well, throwing them away. */
-int invalidWindowHandler(Display *dsp, XErrorEvent *err) {
-	return 0;
-}
 
 /* Grab the device so input is captured */
 void grab(Display* display, int grabDeviceID) {
@@ -210,11 +248,17 @@ void ungrab(Display* display, int grabDeviceID) {
 	}
 }
 
+/* Returns the time on CLOCK_MONOTONIC, the clock of the touch event timestamps and of the loop timers */
 TimeVal getCurrentTime() {
 
-	TimeVal time;
-	gettimeofday(&time, NULL);
+	if(replaying) {
+		return replayTime;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
+	TimeVal time = { now.tv_sec, now.tv_nsec / 1000 };
 	return time;
 }
 
@@ -226,14 +270,104 @@ int timeDiff(TimeVal start, TimeVal end)
 	return (seconds * 1000 + microSeconds/1000);
 }
 
+TimeVal timeAdd(TimeVal time, int milliSeconds)
+{
+	TimeVal diff = { milliSeconds / 1000, (milliSeconds % 1000) * 1000 };
+	TimeVal result;
+	timeradd(&time, &diff, &result);
+	return result;
+}
+
+
+
+/* Set before the threads are started and not changed afterwards */
+int isRecordingTrace() {
+	return recording;
+}
+
+/* Adds a record to the trace, if we are recording one */
+void recordTrace(int type, TouchDevice* device, const void* data, int length) {
+	if(recording) {
+		writeTraceRecord(&trace, type, device != NULL ? device - touchDevices : 0, getCurrentTime(), data, length);
+	}
+}
+
+/* Adds events read from a touch device to the trace, if we are recording one. If events
+ * before them have been lost, they are preceded by a SYN_DROPPED, so that the replay
+ * resyncs where the loss happened. */
+void recordDeviceEvents(TouchDevice* device, struct input_event* ev, int count, int lost) {
+	if(recording) {
+		TraceEvent traceEvents[MAX_READ_EVENTS];
+		if(lost) {
+			struct input_event dropped;
+			memset(&dropped, 0, sizeof(dropped));
+			dropped.input_event_sec = ev[0].input_event_sec;
+			dropped.input_event_usec = ev[0].input_event_usec;
+			dropped.type = EV_SYN;
+			dropped.code = SYN_DROPPED;
+			recordTrace(TRACE_EVENTS, device, traceEvents, encodeTraceEvents(&dropped, 1, traceEvents));
+		}
+		recordTrace(TRACE_EVENTS, device, traceEvents, encodeTraceEvents(ev, count, traceEvents));
+	}
+}
 
+/* Output is flushed once per frame (or easing step) instead of after every event.
+ * Outside of a frame, flushOutput() flushes right away. */
+int outputBatching = 0;
+/* Number of flushes requested in the current batch */
+int batchFlushes = 0;
+/* Statistics: flushes sent to the output and flushes saved by batching */
+long outputFlushes = 0, outputFlushesSaved = 0;
+
+/* Marks the end of a group of output that belongs together */
+void flushOutput() {
+	if (outputBatching) {
+		batchFlushes++;
+	} else {
+		output->flush();
+		outputFlushes++;
+	}
+}
 
-/* Send an XTest event to release the first button if it is currently pressed */
+/* Starts collecting the output of a frame */
+void beginOutputBatch() {
+	outputBatching = 1;
+	batchFlushes = 0;
+}
+
+/* Flushes the output of the frame, if there was any */
+void endOutputBatch() {
+	outputBatching = 0;
+	if (batchFlushes > 0) {
+		output->flush();
+		outputFlushes++;
+		outputFlushesSaved += batchFlushes - 1;
+		if (debugMode && batchFlushes > 1) {
+			printf("Batched output: 1 flush instead of %i\n", batchFlushes);
+		}
+	}
+}
+
+void printOutputStatistics() {
+	printf("Output flushes: %li, saved by batching: %li\n", outputFlushes, outputFlushesSaved);
+}
+
+/* Statistics of the devices that are filtered */
+void printDeviceFilterStatistics() {
+	int i;
+	for(i = 0; i < touchDeviceCount; i++) {
+		if(touchDevices[i].filter.settings.enabled) {
+			printFilterStatistics(&(touchDevices[i].filter), touchDevices[i].name);
+		}
+	}
+}
+
+/* Release the first button if it is currently pressed */
 void releaseButton() {
 	if (buttonDown) {
 		buttonDown = 0;
-		XTestFakeButtonEvent(display, 1, False, CurrentTime);
-		XFlush(display);
+		output->button(1, 0);
+		flushOutput();
 
 /* Experiments with Pressure Sensitivity, not working yet */
 /*		XDevice * dev = XOpenDevice(display, deviceID);
@@ -245,7 +379,7 @@ void releaseButton() {
 		grab(display, deviceID);*/
 	}
 }
-/* Send an XTest event to press the first button if it is not pressed yet */
+/* Press the first button if it is not pressed yet */
 void pressButton() {
 	if(!buttonDown) {
 
@@ -265,8 +399,8 @@ void pressButton() {
 		XCloseDevice(display, dev);
 */
 		buttonDown = 1;
-		XTestFakeButtonEvent(display, 1, True, CurrentTime);
-		XFlush(display);
+		output->button(1, 1);
+		flushOutput();
 	}
 }
 /* Is the first button currently pressed? */
@@ -275,6 +409,18 @@ int isButtonDown() {
 }
 
 
+/* Can scrolling be sent in high resolution instead of button clicks? */
+int canScrollSmoothly() {
+	return smoothScrolling && output->scroll != NULL;
+}
+
+/* Scrolls by the given number of SMOOTH_SCROLL_UNITS; positive is down/right */
+void scrollSmoothly(int dx, int dy) {
+	output->scroll(dx, dy);
+	flushOutput();
+}
+
+
 /* Moves the pointer to the given position */
 void movePointer(int x, int y, int z) {
 	/* Experiments with XI events, not working yet */
@@ -283,97 +429,88 @@ void movePointer(int x, int y, int z) {
 	//	XTestFakeDeviceMotionEvent(display, dev, False, 0, axes, 2, 0);
 	//	XCloseDevice(display, dev);
 
-	XTestFakeMotionEvent(display, -1, x, y, CurrentTime);
-	XFlush(display);
+	output->motion(x, y, screenWidth, screenHeight);
+	flushOutput();
 }
 
 
-/* Executes the given action -- synthesizes key/button press, release or both, depending
- * on value of whatToDo (EXECUTEACTION_PRESS/_RELEASE/_BOTH). */
-void executeAction(Action* action, int whatToDo) {
-	if (whatToDo & EXECUTEACTION_PRESS) {
-		if (action->actionType != ACTIONTYPE_NONE && action->modifier != 0) {
-			if (action->modifier & MODIFIER_SHIFT) {
-				XTestFakeKeyEvent(display,
-						XKeysymToKeycode(display, XK_Shift_L), True,
-						CurrentTime);
-				XFlush(display);
-			}
-			if (action->modifier & MODIFIER_CONTROL) {
-				XTestFakeKeyEvent(display, XKeysymToKeycode(display,
-						XK_Control_L), True, CurrentTime);
-				XFlush(display);
-			}
-			if (action->modifier & MODIFIER_ALT) {
-				XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Alt_L),
-						True, CurrentTime);
-				XFlush(display);
-			}
-			if (action->modifier & MODIFIER_SUPER) {
-				XTestFakeKeyEvent(display,
-						XKeysymToKeycode(display, XK_Super_L), True,
-						CurrentTime);
-				XFlush(display);
-			}
-		}
+static void addActionStep(Action* action, int type, int code, int press) {
+	if (action->stepCount < MAX_ACTION_STEPS) {
+		ActionStep* step = &(action->steps[action->stepCount++]);
+		step->type = type;
+		step->code = code;
+		step->press = press;
+	}
+}
 
-		switch (action->actionType) {
-		case ACTIONTYPE_BUTTONPRESS:
-			XTestFakeButtonEvent(display, action->keyButton, True, CurrentTime);
-			XFlush(display);
-			break;
-		case ACTIONTYPE_KEYPRESS:
-			XTestFakeKeyEvent(display, XKeysymToKeycode(display,
-					action->keyButton), True, CurrentTime);
-			XFlush(display);
-			break;
+static void addModifierSteps(Action* action, int press) {
+	static const int modifiers[] = { MODIFIER_SHIFT, MODIFIER_CONTROL, MODIFIER_ALT, MODIFIER_SUPER };
+	static const KeySym keysyms[] = { XK_Shift_L, XK_Control_L, XK_Alt_L, XK_Super_L };
+	int i;
+	for (i = 0; i < 4; i++) {
+		if (action->modifier & modifiers[i]) {
+			int code = output->keyCode(keysyms[i]);
+			if (code != 0) addActionStep(action, ACTIONSTEP_KEY, code, press);
 		}
-
 	}
+}
 
-	if (whatToDo & EXECUTEACTION_RELEASE) {
-
-		switch (action->actionType) {
-		case ACTIONTYPE_BUTTONPRESS:
-			XTestFakeButtonEvent(display, action->keyButton, False, CurrentTime);
-			XFlush(display);
-			break;
-		case ACTIONTYPE_KEYPRESS:
-			XTestFakeKeyEvent(display, XKeysymToKeycode(display,
-					action->keyButton), False, CurrentTime);
-			XFlush(display);
-			break;
+/* Translates the given action into the events to send, looking up the key codes for the
+ * current output. Has to be done again when the keyboard mapping changes. */
+void compileAction(Action* action) {
+	action->stepCount = 0;
+	action->pressSteps = 0;
+
+	int code = 0;
+	switch (action->actionType) {
+	case ACTIONTYPE_BUTTONPRESS:
+		code = action->keyButton;
+		break;
+	case ACTIONTYPE_KEYPRESS:
+		code = output->keyCode(action->keyButton);
+		break;
+	}
+	if (code == 0) {
+		if (action->actionType != ACTIONTYPE_NONE && debugMode) {
+			printf("No key code for keysym %i, ignoring action\n", action->keyButton);
 		}
+		return;
+	}
+	int type = action->actionType == ACTIONTYPE_BUTTONPRESS ? ACTIONSTEP_BUTTON : ACTIONSTEP_KEY;
 
-		if (action->actionType != ACTIONTYPE_NONE && action->modifier != 0) {
-			if (action->modifier & MODIFIER_SHIFT) {
-				XTestFakeKeyEvent(display,
-						XKeysymToKeycode(display, XK_Shift_L), False,
-						CurrentTime);
-				XFlush(display);
-			}
-			if (action->modifier & MODIFIER_CONTROL) {
-				XTestFakeKeyEvent(display, XKeysymToKeycode(display,
-						XK_Control_L), False, CurrentTime);
-				XFlush(display);
-			}
-			if (action->modifier & MODIFIER_ALT) {
-				XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Alt_L),
-						False, CurrentTime);
-				XFlush(display);
-			}
-			if (action->modifier & MODIFIER_SUPER) {
-				XTestFakeKeyEvent(display,
-						XKeysymToKeycode(display, XK_Super_L), False,
-						CurrentTime);
-				XFlush(display);
-			}
+	addModifierSteps(action, 1);
+	addActionStep(action, type, code, 1);
+	action->pressSteps = action->stepCount;
+	addActionStep(action, type, code, 0);
+	addModifierSteps(action, 0);
+}
+
+/* Executes the given action -- synthesizes key/button press, release or both, depending
+ * on value of whatToDo (EXECUTEACTION_PRESS/_RELEASE/_BOTH). */
+void executeAction(Action* action, int whatToDo) {
+	int first = (whatToDo & EXECUTEACTION_PRESS) ? 0 : action->pressSteps;
+	int last = (whatToDo & EXECUTEACTION_RELEASE) ? action->stepCount : action->pressSteps;
+	int i;
+	if ((whatToDo & EXECUTEACTION_PRESS) && action->actionType != ACTIONTYPE_NONE && output->action != NULL) {
+		output->action(action->actionType, action->keyButton, action->modifier);
+	}
+	for (i = first; i < last; i++) {
+		ActionStep* step = &(action->steps[i]);
+		if (step->type == ACTIONSTEP_BUTTON) {
+			output->button(step->code, step->press);
+		} else {
+			output->key(step->code, step->press);
 		}
+		flushOutput();
 	}
-
 }
 
 Window getParentWindow(Window w) {
+	WindowNode* node = findWindowNode(w);
+	if(node != NULL) {
+		return node->parent != NULL ? node->parent->window : None;
+	}
+
 	Window root, parent;
 	Window* childWindows = NULL;
 	unsigned int childCount;
@@ -389,6 +526,11 @@ Window getParentWindow(Window w) {
 }
 
 Window getLastChildWindow(Window w) {
+	WindowNode* node = findWindowNode(w);
+	if(node != NULL) {
+		return node->lastChild != NULL ? node->lastChild->window : None;
+	}
+
 	Window root, parent;
 	Window* childWindows = NULL;
 	unsigned int childCount;
@@ -415,6 +557,8 @@ void storePrevMousePos() {
 	int win_x_return = 0, win_y_return = 0;
 	unsigned int mask_return = 0;
 
+	if(replaying) return;
+
 	if (XQueryPointer(display, root, &root_return, &child_return, &root_x_return, &root_y_return, 
                      &win_x_return, &win_y_return, &mask_return) == True) {
 		prevMouseX = root_x_return;
@@ -423,6 +567,23 @@ void storePrevMousePos() {
 
 }
 
+void recordActiveWindow(Window window, const char* class) {
+	char data[256];
+	int length = 1;
+	data[0] = TRACE_WINDOW_NONE;
+	if(window != None) {
+		data[0] = TRACE_WINDOW_NO_CLASS;
+		if(class != NULL) {
+			data[0] = TRACE_WINDOW_CLASS;
+			int classLength = strlen(class);
+			if(classLength > sizeof(data) - 1) classLength = sizeof(data) - 1;
+			memcpy(data + 1, class, classLength);
+			length = 1 + classLength;
+		}
+	}
+	recordTrace(TRACE_ACTIVE_WINDOW, NULL, data, length);
+}
+
 Window getActiveWindow() {
 
 /*	Window *root_return = None, *child_return = None;
@@ -434,8 +595,147 @@ Window getActiveWindow() {
                      win_x_return, win_y_return, mask_return);
 
 	return *child_return;*/
-	return getCurrentWindow();
 
+	if(replaying) {
+		/* The window as it was when the trace was recorded; its class is returned by getWindowClass() */
+		TraceRecord record;
+		if(peekTraceRecordType(&trace) != TRACE_ACTIVE_WINDOW || readTraceRecord(&trace, &record) <= 0
+				|| record.length < 1 || record.data[0] == TRACE_WINDOW_NONE) {
+			return None;
+		}
+		free(replayWindowClass);
+		replayWindowClass = record.data[0] == TRACE_WINDOW_CLASS ? strdup((char*) record.data + 1) : NULL;
+		return root != None ? root : 1;
+	}
+
+	Window window = getCurrentWindow();
+
+	if(recording) {
+		char* class = window != None ? getWindowClass(window) : NULL;
+		recordActiveWindow(window, class);
+		free(class);
+	}
+
+	return window;
+}
+
+/* Frees the profile sets replaced by reloads once no gesture or easing uses them anymore */
+void freeRetiredProfiles() {
+	int i;
+	if(retiredProfiles == NULL || isEasingActive()) {
+		return;
+	}
+	for(i = 0; i < touchDeviceCount; i++) {
+		if(touchDevices[i].fingersWereDown > 0) {
+			return;
+		}
+	}
+
+	/* Idle devices may still point to a profile of an old set */
+	for(i = 0; i < touchDeviceCount; i++) {
+		touchDevices[i].recognizer.currentProfile = getDefaultProfile();
+	}
+	while(retiredProfiles != NULL) {
+		ProfileSet* next = retiredProfiles->nextRetired;
+		freeProfileSet(retiredProfiles);
+		retiredProfiles = next;
+	}
+}
+
+/* Loads the profiles from the configuration file, if there is one. The profiles in use
+ * are kept if it can't be loaded. */
+void loadProfiles() {
+	if(configFile == NULL) {
+		return;
+	}
+	ProfileSet* set = loadProfileSet(configFile, configCacheFile);
+	if(set == NULL) {
+		fprintf(stderr, "WARNING: Couldn't load profiles from %s\n", configFile);
+		return;
+	}
+
+	ProfileSet* previous = setProfileSet(set);
+	compileProfileActions();
+	if(previous != NULL && previous->ownsMemory) {
+		previous->nextRetired = retiredProfiles;
+		retiredProfiles = previous;
+		freeRetiredProfiles();
+	}
+	if(display != NULL && !replaying) {
+		activeProfile = getClassProfile(activeClassId);
+		/* The blacklist may have changed */
+		updatePassthrough();
+	}
+}
+
+/* Looks up the active window and its profile. Called when the focus changes, so that
+ * nothing has to be asked from the X server when a gesture starts. */
+void updateActiveWindow() {
+	activeWindow = getCurrentWindow();
+	activeClassId = activeWindow != None ? getWindowClassId(activeWindow) : CLASS_NONE;
+	activeProfile = getClassProfile(activeClassId);
+	if(debugMode) printf("Active window changed: %s\n", activeClassId != CLASS_NONE ? getClassName(activeClassId) : "(none)");
+	updatePassthrough();
+}
+
+/* Schedules switching passthrough on or off if the active window calls for it. The switch
+ * happens only after the focus has stayed for PASSTHROUGH_DELAY_MS, so that quickly
+ * switching through windows doesn't grab and ungrab the devices every time. */
+void updatePassthrough() {
+	if(passthroughTimerDesc < 0) {
+		return;
+	}
+	int wanted = isWindowBlacklisted(activeWindow);
+	if(wanted != passthrough) {
+		TimeVal deadline = timeAdd(getCurrentTime(), PASSTHROUGH_DELAY_MS);
+		setLoopTimer(passthroughTimerDesc, &deadline);
+	} else {
+		/* Back to where we were before it settled */
+		setLoopTimer(passthroughTimerDesc, NULL);
+	}
+}
+
+/* The focus has settled: grab or ungrab the devices. Waits for touches to end first. */
+void handlePassthroughTimer(int timerDesc, void* data) {
+	int i;
+	int wanted = isWindowBlacklisted(activeWindow);
+	if(wanted == passthrough) {
+		return;
+	}
+	for(i = 0; i < touchDeviceCount; i++) {
+		if(touchDevices[i].fileDesc >= 0 && touchDevices[i].fingersWereDown > 0) {
+			TimeVal deadline = timeAdd(getCurrentTime(), PASSTHROUGH_DELAY_MS);
+			setLoopTimer(passthroughTimerDesc, &deadline);
+			return;
+		}
+	}
+
+	passthrough = wanted;
+	if(debugMode) printf("%s passthrough\n", passthrough ? "Start" : "Stop");
+	if(passthrough) {
+		stopEasing();
+	}
+	for(i = 0; i < touchDeviceCount; i++) {
+		if(touchDevices[i].fileDesc >= 0) {
+			if(passthrough) {
+				ungrab(display, touchDevices[i].deviceID);
+			} else {
+				grab(display, touchDevices[i].deviceID);
+			}
+		}
+	}
+}
+
+/* Returns the profile of the active window. Without a window manager that announces the
+ * active window, or when replaying, it has to be looked up right now. */
+Profile* getActiveProfile() {
+	if(replaying || !activeWindowTracked) {
+		return getWindowProfile(getActiveWindow());
+	}
+	if(recording) {
+		recordActiveWindow(activeWindow, getClassName(activeClassId));
+	}
+	return activeProfile;
 }
 
 /* Returns the active top-level window. A top-level window is one that has WM_CLASS set.
@@ -453,7 +753,14 @@ Window getCurrentWindow() {
 	}
 
 	/* Now go through parent windows until we find one with WM_CLASS set. */
-
+	WindowNode* node = findWindowNode(currentWindow);
+	if (node != NULL) {
+		/* Known window, walk up the mirrored tree */
+		while (node != NULL && node->window != root && !node->hasClassHint) {
+			node = node->parent;
+		}
+		return node != NULL ? node->window : None;
+	}
 
 	XClassHint* classHint = XAllocClassHint();
 	if(classHint == NULL) {
@@ -505,27 +812,27 @@ Window getCurrentWindow() {
 
 
 /* Sets the calibrated x, y coordinates from the raw coordinates in the given FingerInfo */
-void calibrate(FingerInfo* fingerInfo) {
+void calibrate(TouchDevice* device, FingerInfo* fingerInfo) {
 	float xf; float yf;
-	if (calibSwapAxes) {
+	if (device->calibSwapAxes) {
 
-		xf = ((float)(fingerInfo->rawY - calibMinX))/((float) (calibMaxX-calibMinX));
-		yf = ((float)(fingerInfo->rawX - calibMinY))/((float) (calibMaxY-calibMinY));
+		xf = ((float)(fingerInfo->rawY - device->calibMinX))/((float) (device->calibMaxX-device->calibMinX));
+		yf = ((float)(fingerInfo->rawX - device->calibMinY))/((float) (device->calibMaxY-device->calibMinY));
 
 	} else {
 
-		xf = ((float)(fingerInfo->rawX - calibMinX))/((float) (calibMaxX-calibMinX));
-		yf = ((float)(fingerInfo->rawY - calibMinY))/((float) (calibMaxY-calibMinY));
+		xf = ((float)(fingerInfo->rawX - device->calibMinX))/((float) (device->calibMaxX-device->calibMinX));
+		yf = ((float)(fingerInfo->rawY - device->calibMinY))/((float) (device->calibMaxY-device->calibMinY));
 
 	}
-	if (calibSwapX) xf = 1 - xf;
-	if (calibSwapY) yf = 1 - yf;
+	if (device->calibSwapX) xf = 1 - xf;
+	if (device->calibSwapY) yf = 1 - yf;
 
-	if(calibMatrixUse) {
+	if(device->calibMatrixUse) {
 		float xfold = xf;
 		/* Apply matrix transformation */
-		xf = xf * calibMatrix[0] + yf * calibMatrix[1] + calibMatrix[2];
-		yf = xfold * calibMatrix[3] + yf * calibMatrix[4] + calibMatrix[5];
+		xf = xf * device->calibMatrix[0] + yf * device->calibMatrix[1] + device->calibMatrix[2];
+		yf = xfold * device->calibMatrix[3] + yf * device->calibMatrix[4] + device->calibMatrix[5];
 	}
 
 	fingerInfo->x = xf * screenWidth;
@@ -543,49 +850,130 @@ void calibrate(FingerInfo* fingerInfo) {
 
 }
 
-/* Process the finger data gathered from the last set of events */
-void processFingers() {
-	int i;
-	fingersDown = 0;
-	for(i = 0; i < 2; i++) {
-		if(fingerInfos[i].slotUsed) {
-			calibrate(&(fingerInfos[i]));
-			fingersDown++;
+/* Performs what the gesture recognizer of a device has asked for */
+void performGestureOutputs(GestureRecognizer* recognizer, TimeVal time) {
+	int i, n;
+	for(i = 0; i < recognizer->outputCount; i++) {
+		GestureOutput* out = &(recognizer->outputs[i]);
+		switch(out->type) {
+		case GESTUREOUTPUT_ACTION:
+			for(n = 0; n < out->z; n++) {
+				executeAction(out->action, out->what);
+			}
+			break;
+		case GESTUREOUTPUT_MOVE:
+			movePointer(out->x, out->y, out->z);
+			break;
+		case GESTUREOUTPUT_PRESS:
+			pressButton();
+			break;
+		case GESTUREOUTPUT_RELEASE:
+			releaseButton();
+			break;
+		case GESTUREOUTPUT_SCROLL:
+			scrollSmoothly(out->x, out->y);
+			break;
+		case GESTUREOUTPUT_START_EASING:
+			startEasing(out->profile, out->x, out->y, time);
+			break;
+		case GESTUREOUTPUT_STOP_EASING:
+			stopEasing();
+			break;
 		}
 	}
+}
+
+/* Aborts the gesture of a device without performing any more actions */
+void cancelGesture(TouchDevice* device, TimeVal time) {
+	cancelFingerGesture(&(device->recognizer));
+	performGestureOutputs(&(device->recognizer), time);
+}
+
+/* Process the finger data of a frame of the device */
+void processFingers(TouchDevice* device, InputFrame* frame) {
+	int i;
+	FingerInfo* contacts = frame->contacts;
+	int fingersDown = frame->contactCount;
+	device->fingersDown = fingersDown;
+	for(i = 0; i < fingersDown; i++) {
+		calibrate(device, &(contacts[i]));
+	}
+
+	TimeVal frameTime = frame->time;
+
+	if(frame->resynced) {
+		/* Events have been lost, so we don't know what happened since the last frame.
+		 * Drop the current gesture and treat the fingers that are on as new touches. */
+		if(debugMode) printf("Events dropped, resynced with %i fingers on\n", fingersDown);
+		cancelGesture(device, frameTime);
+		device->fingersWereDown = 0;
+		device->currentTouchBlocked = 0;
+		resetTouchFilter(&(device->filter));
+	}
+
+	if(device->filter.settings.enabled) {
+		filterContacts(&(device->filter), contacts, fingersDown, frameTime, screenWidth, screenHeight);
+	}
+
+	int fingersWereDown = device->fingersWereDown;
 
 	if(fingersWereDown == 0 && 
 	   fingersDown > 0 && 
 	   blockingDeviceID != -1 && 
-	   timeDiff(lastBlockingInputTime, getCurrentTime()) < blockingIntervalMilliseconds) {
-		currentTouchBlocked = 1;
+	   timeDiff(lastBlockingInputTime, frameTime) < blockingIntervalMilliseconds) {
+		device->currentTouchBlocked = 1;
 		if(debugMode) printf("Touch blocked.\n");
 	}
 
-	if(moveMouseBackAfterTouches && !currentTouchBlocked && fingersDown > 0 && fingersWereDown == 0) {
+	if(moveMouseBackAfterTouches && !device->currentTouchBlocked && fingersDown > 0 && fingersWereDown == 0) {
 		storePrevMousePos();
 	}
 
 
-	if(!currentTouchBlocked || !alsoBlockTwoFingerTouches) {
-		processFingerGesture(fingerInfos, fingersDown, fingersWereDown, currentTouchBlocked);
+	if(!device->currentTouchBlocked || !alsoBlockTwoFingerTouches) {
+		recognizeGesture(&(device->recognizer), contacts, fingersDown, device->currentTouchBlocked, frameTime);
+		performGestureOutputs(&(device->recognizer), frameTime);
+	}
+
+	if(debugMode) {
+		/* Input-to-output latency, including the time the events were queued in the kernel */
+		TimeVal now = getCurrentTime();
+		TimeVal latency;
+		timersub(&now, &frameTime, &latency);
+		long latencyMicroSeconds = latency.tv_sec * 1000000L + latency.tv_usec;
+		if(latencyMicroSeconds > device->maxLatency) device->maxLatency = latencyMicroSeconds;
+		if(fingersDown == 0 && fingersWereDown > 0) {
+			printf("Touch ended, max. latency %li us\n", device->maxLatency);
+			device->maxLatency = 0;
+		}
 	}
 
 	if(fingersDown == 0) {
-		currentTouchBlocked = 0;
+		device->currentTouchBlocked = 0;
 		if(fingersWereDown > 0 && moveMouseBackAfterTouches) {
 			movePointer(prevMouseX, prevMouseY, 0);
 		}
 	}
 
 	/* Save number of fingers to compare next time */
-	fingersWereDown = fingersDown;
+	device->fingersWereDown = fingersDown;
+
+	if(fingersDown == 0) {
+		freeRetiredProfiles();
+	}
 }
 
 /* Returns a pointer to the profile of the currently selected
  * window, or defaultProfile if there is no specific profile for it or the window is invalid. */
 char* getWindowClass(Window w) {
 	char * result = NULL;
+	if(replaying) {
+		return replayWindowClass != NULL ? strdup(replayWindowClass) : NULL;
+	}
+	WindowNode* node = findWindowNode(w);
+	if(node != NULL) {
+		return node->classId != CLASS_NONE ? strdup(getClassName(node->classId)) : NULL;
+	}
 	if (w != None) {
 
 		XClassHint* classHint = XAllocClassHint();
@@ -613,6 +1001,18 @@ char* getWindowClass(Window w) {
 }
 
 
+/* Returns the interned class of the given window, CLASS_NONE if it has none */
+int getWindowClassId(Window w) {
+	WindowNode* node = replaying ? NULL : findWindowNode(w);
+	if(node != NULL) {
+		return node->classId;
+	}
+	char* class = getWindowClass(w);
+	int id = internClass(class);
+	free(class);
+	return id;
+}
+
 /* Returns whether the given window is blacklisted */
 int isWindowBlacklisted(Window w) {
 	if(w == None) return 0;
@@ -620,9 +1020,15 @@ int isWindowBlacklisted(Window w) {
 	return isWindowBlacklistedForGestures(w);
 }
 
+void recordScreenSize() {
+	int32_t size[2] = { screenWidth, screenHeight };
+	recordTrace(TRACE_SCREEN_SIZE, NULL, size, sizeof(size));
+}
+
 void setScreenSize(XRRScreenChangeNotifyEvent * evt) {
 	screenWidth = evt->width;
 	screenHeight = evt->height;
+	recordScreenSize();
 	if(debugMode) {
 		printf("New screen size: %i x %i\n", screenWidth, screenHeight);
 	}
@@ -644,13 +1050,30 @@ void handleXEvent() {
 				// Blocking event received
 				if(debugMode) printf("Blocking for next %i milliseconds.\n", blockingIntervalMilliseconds);
 				lastBlockingInputTime = getCurrentTime();
+				recordTrace(TRACE_BLOCKING_INPUT, NULL, NULL, 0);
+			}
+		}
+
+		if (cookie->evtype == XI_HierarchyChanged) {
+			XIHierarchyEvent * hierarchyEvt = (XIHierarchyEvent*) cookie->data;
+			if(hierarchyEvt->flags & (XISlaveAdded | XIDeviceEnabled)) {
+				/* Maybe X didn't know a device yet when its file appeared */
+				openMissingDevices();
 			}
 		}
 
 		if (cookie->evtype == XI_PropertyEvent) {
 			/* Device properties changed -> recalibrate. */
-			if(debugMode) printf("Device properties changed.\n");
-			readCalibrationData(0, NULL);
+			XIPropertyEvent * propEvt = (XIPropertyEvent*) cookie->data;
+			int i;
+			for(i = 0; i < touchDeviceCount; i++) {
+				TouchDevice* device = &(touchDevices[i]);
+				if(device->fileDesc >= 0 && (device->deviceID == propEvt->deviceid
+						|| device->calibrateDeviceID == propEvt->deviceid)) {
+					if(debugMode) printf("Device properties of \"%s\" changed.\n", device->name);
+					readCalibrationData(device);
+				}
+			}
 		}
 
 		/*if (cookie->evtype == XI_Motion) {
@@ -719,14 +1142,55 @@ void handleXEvent() {
 		XFreeEventData(display, &(ev.xcookie));
 
 	} else {
+		updateWindowTree(&ev);
+
 		if(ev.type == randrEvBase + RRScreenChangeNotify) {
 			setScreenSize((XRRScreenChangeNotifyEvent *) &ev);
+		} else if(ev.type == PropertyNotify && ev.xproperty.atom == NET_ACTIVE_WINDOW) {
+			activeWindowTracked = 1;
+			updateActiveWindow();
+		} else if(ev.type == FocusIn || ev.type == FocusOut) {
+			updateActiveWindow();
+		} else if(ev.type == MappingNotify) {
+			/* Key codes may have changed */
+			XRefreshKeyboardMapping(&(ev.xmapping));
+			if(outputDisplay != display) {
+				/* The output looks key codes up on its own connection, which never reads
+				   its events, so its mapping is refreshed from here as well */
+				XMappingEvent outputMapping = ev.xmapping;
+				outputMapping.display = outputDisplay;
+				XRefreshKeyboardMapping(&outputMapping);
+			}
+			if(ev.xmapping.request != MappingPointer) {
+				if(debugMode) printf("Keyboard mapping changed.\n");
+				compileProfileActions();
+			}
 		}
 	}
 }
 
+void recordCalibration(TouchDevice* device) {
+	if(recording) {
+		TraceCalibration calibration;
+		int i;
+		memset(&calibration, 0, sizeof(calibration));
+		calibration.minX = device->calibMinX;
+		calibration.maxX = device->calibMaxX;
+		calibration.minY = device->calibMinY;
+		calibration.maxY = device->calibMaxY;
+		calibration.swapX = device->calibSwapX;
+		calibration.swapY = device->calibSwapY;
+		calibration.swapAxes = device->calibSwapAxes;
+		calibration.matrixUse = device->calibMatrixUse;
+		for(i = 0; i < 6; i++) {
+			calibration.matrix[i] = device->calibMatrix[i];
+		}
+		recordTrace(TRACE_CALIBRATION, device, &calibration, sizeof(calibration));
+	}
+}
+
 /* Reads the calibration data from evdev, should be self-explanatory. */
-void readCalibrationData(int exitOnFail, char* deviceName) {
+void readCalibrationData(TouchDevice* device) {
 	if(debugMode) {
 		printf("Start calibration\n");
 	}
@@ -734,7 +1198,7 @@ void readCalibrationData(int exitOnFail, char* deviceName) {
 	int retFormat;
 	unsigned long retItems, retBytesAfter;
 	unsigned int* data;
-	if(XIGetProperty(display, calibrateDeviceID, XInternAtom(display,
+	if(XIGetProperty(display, device->calibrateDeviceID, XInternAtom(display,
 			"Evdev Axis Calibration", 0), 0, 4 * 32, False, XA_INTEGER,
 			&retType, &retFormat, &retItems, &retBytesAfter,
 			(unsigned char**) &data) != Success) {
@@ -742,68 +1206,51 @@ void readCalibrationData(int exitOnFail, char* deviceName) {
 	}
 
 	if (data == NULL || retItems != 4 || data[0] == data[1] || data[2] == data[3]) {
-		/* evdev might not be ready yet after resume. Let's wait a second and try again. */
-		sleep(1);
-
-		if(XIGetProperty(display, calibrateDeviceID, XInternAtom(display,
-				"Evdev Axis Calibration", 0), 0, 4 * 32, False, XA_INTEGER,
-				&retType, &retFormat, &retItems, &retBytesAfter,
-				(unsigned char**) &data) != Success) {
-					retItems = 0;
-				return;
+		/* evdev might not be ready yet after resume. Use the axis ranges for now; as soon
+		 * as evdev sets the property, the property event makes us read it again. */
+		if(debugMode) {
+			printf("No calibration data found, use default values.\n");
 		}
 
-		if (retItems != 4 || data[0] == data[1] || data[2] == data[3]) {
-
+		/* Get minimum/maximum of axes */
+		if (strcmp(device->name, "ELAN9009:00 04F3:29DE") == 0) {
 			if(debugMode) {
-				printf("No calibration data found, use default values.\n");
+				printf("Using fixed values for ELAN device for now.\n");
 			}
-
-			/* Get minimum/maximum of axes */
-			if (strcmp(deviceName, "ELAN9009:00 04F3:29DE") == 0) {
-				if(debugMode) {
-					printf("Using fixed values for ELAN device for now.\n");
-				}
-				calibMaxX = 3600;
-				calibMaxY = 960;
-			} else {
-				int nDev;
-				XIDeviceInfo * deviceInfo = XIQueryDevice(display, calibrateDeviceID, &nDev);
-
-				int c;
-				for(c = 0; c < deviceInfo->num_classes; c++) {
-					if(deviceInfo->classes[c]->type == XIValuatorClass) {
-						XIValuatorClassInfo* valuatorInfo = (XIValuatorClassInfo *) deviceInfo->classes[c];
-						if(valuatorInfo->mode == XIModeAbsolute) {
-							if(valuatorInfo->label == XInternAtom(display, "Abs X", 0)
-							|| valuatorInfo->label == XInternAtom(display, "Abs MT Position X", 0)) 
-							{
-								calibMinX = valuatorInfo->min;
-								calibMaxX = valuatorInfo->max;
-							}
-							else if(valuatorInfo->label == XInternAtom(display, "Abs Y", 0)
-							|| valuatorInfo->label == XInternAtom(display, "Abs MT Position Y", 0))
-							{
-								calibMinY = valuatorInfo->min;
-								calibMaxY = valuatorInfo->max;
-							}
+			device->calibMaxX = 3600;
+			device->calibMaxY = 960;
+		} else {
+			int nDev;
+			XIDeviceInfo * deviceInfo = XIQueryDevice(display, device->calibrateDeviceID, &nDev);
+
+			int c;
+			for(c = 0; deviceInfo != NULL && c < deviceInfo->num_classes; c++) {
+				if(deviceInfo->classes[c]->type == XIValuatorClass) {
+					XIValuatorClassInfo* valuatorInfo = (XIValuatorClassInfo *) deviceInfo->classes[c];
+					if(valuatorInfo->mode == XIModeAbsolute) {
+						if(valuatorInfo->label == XInternAtom(display, "Abs X", 0)
+						|| valuatorInfo->label == XInternAtom(display, "Abs MT Position X", 0)) 
+						{
+							device->calibMinX = valuatorInfo->min;
+							device->calibMaxX = valuatorInfo->max;
+						}
+						else if(valuatorInfo->label == XInternAtom(display, "Abs Y", 0)
+						|| valuatorInfo->label == XInternAtom(display, "Abs MT Position Y", 0))
+						{
+							device->calibMinY = valuatorInfo->min;
+							device->calibMaxY = valuatorInfo->max;
 						}
 					}
 				}
-
-				XIFreeDeviceInfo(deviceInfo);
 			}
-		} else {
-			calibMinX = data[0];
-			calibMaxX = data[1];
-			calibMinY = data[2];
-			calibMaxY = data[3];
+
+			if(deviceInfo != NULL) XIFreeDeviceInfo(deviceInfo);
 		}
 	} else {
-		calibMinX = data[0];
-		calibMaxX = data[1];
-		calibMinY = data[2];
-		calibMaxY = data[3];
+		device->calibMinX = data[0];
+		device->calibMaxX = data[1];
+		device->calibMinY = data[2];
+		device->calibMaxY = data[3];
 	}
 
 	if(data != NULL) {
@@ -811,21 +1258,21 @@ void readCalibrationData(int exitOnFail, char* deviceName) {
 	}
 
 	float * data4 = NULL;
-	if(XIGetProperty(display, calibrateDeviceID, XInternAtom(display,
+	if(XIGetProperty(display, device->calibrateDeviceID, XInternAtom(display,
 			"Coordinate Transformation Matrix", 0), 0, 9 * 32, False, XInternAtom(display,
 			"FLOAT", 0),
 			&retType, &retFormat, &retItems, &retBytesAfter,
 			(unsigned char **) &data4) != Success) {
 		data4 = NULL;
 	}
-	calibMatrixUse = 0;
+	device->calibMatrixUse = 0;
 	if(data4 != NULL && retItems == 9) {
 		int i;
 		for(i = 0; i < 6; i++) {
 			/* We only take the first two rows of the matrix, the rest is unimportant anyway */
-			calibMatrix[i] = data4[i];
+			device->calibMatrix[i] = data4[i];
 		}
-		calibMatrixUse = 1;
+		device->calibMatrixUse = 1;
 	}
 	if(data4 != NULL) {
 		XFree(data4);
@@ -833,58 +1280,65 @@ void readCalibrationData(int exitOnFail, char* deviceName) {
 
 
 
-	unsigned char* data2;
+	unsigned char* data2 = NULL;
 
-	if(XIGetProperty(display, calibrateDeviceID, XInternAtom(display,
+	if(XIGetProperty(display, device->calibrateDeviceID, XInternAtom(display,
 			"Evdev Axis Inversion", 0), 0, 2 * 8, False, XA_INTEGER, &retType,
 			&retFormat, &retItems, &retBytesAfter, (unsigned char**) &data2) != Success) {
-		retItems = 0;
+		data2 = NULL;
 	}
 
-	if (retItems != 2) {
+	if (data2 == NULL || retItems != 2) {
 		if (debugMode) {
 			printf("No valid axis inversion data found, assuming no inversion.\n");
 		}
-		calibSwapX = 0;
-		calibSwapY = 0;
+		device->calibSwapX = 0;
+		device->calibSwapY = 0;
 	} else {
-	 	calibSwapX = data2[0];
-		calibSwapY = data2[1];
+	 	device->calibSwapX = data2[0];
+		device->calibSwapY = data2[1];
 	}
 
 
-	XFree(data2);
+	if(data2 != NULL) {
+		XFree(data2);
+	}
 
-	if(XIGetProperty(display, calibrateDeviceID,
+	data2 = NULL;
+	if(XIGetProperty(display, device->calibrateDeviceID,
 			XInternAtom(display, "Evdev Axes Swap", 0), 0, 8, False,
 			XA_INTEGER, &retType, &retFormat, &retItems, &retBytesAfter,
 			(unsigned char**) &data2) != Success) {
-		retItems = 0;
+		data2 = NULL;
 	}
 
-	if (retItems != 1) {
+	if (data2 == NULL || retItems != 1) {
 		if (debugMode)
 		{
 			printf("No valid axes swap data found, assuming no swap.\n");
 		}
-		calibSwapAxes = 0;
+		device->calibSwapAxes = 0;
 	}
 		else
 	{
-		calibSwapAxes = data2[0];
+		device->calibSwapAxes = data2[0];
 	}
 
-	XFree(data2);
+	if(data2 != NULL) {
+		XFree(data2);
+	}
+
+	recordCalibration(device);
 
 	if(debugMode)
 	{
-		printf("Calibration: MinX: %i; MaxX: %i; MinY: %i; MaxY: %i\n", calibMinX, calibMaxX, calibMinY, calibMaxY);
-		printf("Invert X Axis: %s\n", calibSwapX ? "Yes" : "No");
-		printf("Invert Y Axis: %s\n", calibSwapY ? "Yes" : "No");
-		printf("Swap Axes: %s\n", calibSwapAxes ? "Yes" : "No");
-		if(calibMatrixUse)
+		printf("Calibration: MinX: %i; MaxX: %i; MinY: %i; MaxY: %i\n", device->calibMinX, device->calibMaxX, device->calibMinY, device->calibMaxY);
+		printf("Invert X Axis: %s\n", device->calibSwapX ? "Yes" : "No");
+		printf("Invert Y Axis: %s\n", device->calibSwapY ? "Yes" : "No");
+		printf("Swap Axes: %s\n", device->calibSwapAxes ? "Yes" : "No");
+		if(device->calibMatrixUse)
 		{
-			printf("Calibration Matrix: \t%f\t%f\t%f\n                    \t%f\t%f\t%f\n", calibMatrix[0], calibMatrix[1], calibMatrix[2], calibMatrix[3], calibMatrix[4], calibMatrix[5]);
+			printf("Calibration Matrix: \t%f\t%f\t%f\n                    \t%f\t%f\t%f\n", device->calibMatrix[0], device->calibMatrix[1], device->calibMatrix[2], device->calibMatrix[3], device->calibMatrix[4], device->calibMatrix[5]);
 		}
 	}
 
@@ -895,26 +1349,522 @@ int isEasingEnabled()
 	return !moveMouseBackAfterTouches;
 }
 
-void * signalThreadFunction(void *arg) {
-	int sig;
-	while(1) {
-		sigwait ( &signalSet, &sig );
-		/* Trigger update of profile settings */
-		stopSignalReceived = 1;
-		return 0;
+/* A signal arrived on the signalfd */
+void handleSignal(int signalDesc, void* data) {
+	struct signalfd_siginfo info;
+	if(read(signalDesc, &info, sizeof(info)) == sizeof(info)) {
+		if(info.ssi_signo == SIGHUP) {
+			if(debugMode) printf("Reloading profiles.\n");
+			loadProfiles();
+		} else {
+			stopSignalReceived = 1;
+		}
+	}
+}
+
+/* The X connection is readable; handle everything that is queued. */
+void handleXEvents(int eventQueueDesc, void* data) {
+	while(XPending(display) > 0) {
+		handleXEvent();
+	}
+	processPendingWindows();
+}
+
+/* Looks up the XInput ids of the given touch device (and of the device to read its
+ * calibration from) by its name. Returns 0 on success, -1 if it is not known to X. */
+int findXInputDevice(TouchDevice* device) {
+	int i;
+
+	/* Look if a mapping is available and, if yes, map calibration device name */
+	char calibrateName[256];
+	strcpy(calibrateName, device->name);
+	for(i = 0; mapDeviceNameForCalibration[i].origDeviceName != NULL; i++)
+	{
+		if(strcmp(device->name, mapDeviceNameForCalibration[i].origDeviceName) == 0)
+		{
+			strcpy(calibrateName, mapDeviceNameForCalibration[i].mappedDeviceName);
+			printf("For calibration: \"%s\"\n", calibrateName);
+			break;
+		}
+	}
+
+	int n;
+	XIDeviceInfo *info = XIQueryDevice(display, XIAllDevices, &n);
+	if (!info) {
+		return -1;
+	}
+
+	/* Go through input devices and look for that with the same name as the given device */
+	device->deviceID = -1;
+	device->calibrateDeviceID = -1;
+	int devindex;
+	for(devindex = 0; devindex < n; devindex++) {
+		if(info[devindex].use == XIMasterPointer 
+		   || info[devindex].use == XIMasterKeyboard
+		   || info[devindex].use == XISlaveKeyboard)
+			continue;
+
+		if(strcmp(info[devindex].name, device->name) == 0 && device->deviceID == -1) {
+			device->deviceID = info[devindex].deviceid;
+		}
+		if(strcmp(info[devindex].name, calibrateName) == 0 && device->calibrateDeviceID == -1) {
+			device->calibrateDeviceID = info[devindex].deviceid;
+		}
+	}
+
+	XIFreeDeviceInfo(info);
+
+	if(device->deviceID == -1) {
+		return -1;
+	}
+	if(device->calibrateDeviceID == -1) {
+		printf("Using default device for calibration\n");
+		device->calibrateDeviceID = device->deviceID;
+	}
+
+	if(debugMode) printf("XInput device id is %i.\n", device->deviceID);
+	if(debugMode) printf("XInput device id for calibration is %i.\n", device->calibrateDeviceID);
+	return 0;
+}
+
+/* Looks up the XInput id of the blocking device and selects its events */
+void findBlockingDevice() {
+	int n;
+	XIDeviceInfo *info = XIQueryDevice(display, XIAllDevices, &n);
+	if (!info) {
+		return;
+	}
+
+	blockingDeviceID = -1;
+	int devindex;
+	for(devindex = 0; devindex < n; devindex++) {
+		if(info[devindex].use == XIMasterPointer 
+		   || info[devindex].use == XIMasterKeyboard
+		   || info[devindex].use == XISlaveKeyboard)
+			continue;
+
+		if(strcmp(info[devindex].name, blockingDevName) == 0 && blockingDeviceID == -1) {
+			blockingDeviceID = info[devindex].deviceid;
+		}
+	}
+	XIFreeDeviceInfo(info);
+
+	if(blockingDeviceID == -1) {
+		printf("WARNING: Blocking device \"%s\" not found in XInput device list!\n", blockingDevName);
+		return;
+	}
+	printf("Blocking on device %i.\n", blockingDeviceID);
+
+	/* Receive events from blocking device */
+	XIEventMask device_mask3;
+	unsigned char mask_data3[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	device_mask3.deviceid = blockingDeviceID;
+	device_mask3.mask_len = sizeof(mask_data3);
+	device_mask3.mask = mask_data3;
+	XISetMask(device_mask3.mask, XI_ButtonPress);
+	XISetMask(device_mask3.mask, XI_Motion);
+	XISelectEvents(display, root, &device_mask3, 1);
+}
+
+/* Stops reading from the given touch device and releases it */
+void closeTouchDevice(TouchDevice* device) {
+	recordTrace(TRACE_DEVICE_CLOSED, device, NULL, 0);
+
+	unwatchTouchDevice(device);
+	close(device->fileDesc);
+	device->fileDesc = -1;
+	freeDecoder(&(device->decoder));
+
+	/* Clean up */
+	if(device->fingersWereDown > 0) {
+		cancelGesture(device, getCurrentTime());
+	}
+	device->fingersWereDown = 0;
+	ungrab(display, device->deviceID);
+}
+
+/* Processes a frame the input thread has read and decoded */
+void handleInputFrame(InputFrame* frame) {
+	TouchDevice* device = frame->device;
+	if(frame->type == INPUTFRAME_EVENTS) {
+		recordDeviceEvents(device, frame->events, frame->eventCount, frame->resynced);
+		return;
+	}
+	if(frame->type == INPUTFRAME_STOPPED) {
+		/* Stream stopped, probably because module has been unloaded */
+		printf("Data stream of \"%s\" stopped\n", device->name);
+		closeTouchDevice(device);
+		/* The device file may have been created again before we got here, in which
+		   case its inotify event has been ignored */
+		if(access(device->devName, F_OK) == 0) {
+			if(debugMode) printf("%s is back.\n", device->devName);
+			openTouchDevice(device);
+		}
+		return;
+	}
+	if(passthrough) {
+		/* The window gets the touches itself; only keep track of the fingers */
+		device->fingersDown = frame->contactCount;
+		device->fingersWereDown = device->fingersDown;
+		return;
+	}
+	beginOutputBatch();
+	processFingers(device, frame);
+	endOutputBatch();
+}
+
+/* Decodes the given events of a touch device and processes every complete frame right
+ * away, without the input thread. Returns the number of frames. */
+int processDeviceEvents(TouchDevice* device, struct input_event* ev, int count) {
+	int i, consumed;
+	int frames = 0;
+	InputFrame frame;
+	for (i = 0; i < count; i += consumed) {
+		if (decodeEvents(&(device->decoder), &ev[i], count - i, &consumed) == DECODE_FRAME) {
+			takeInputFrame(device, &frame);
+			handleInputFrame(&frame);
+			frames++;
+		}
+	}
+	return frames;
+}
+
+/* Clears the finger and gesture state of a touch device that has just been opened */
+void resetTouchDevice(TouchDevice* device) {
+	device->fingersDown = 0;
+	device->fingersWereDown = 0;
+	device->currentTouchBlocked = 0;
+	device->maxLatency = 0;
+	device->framesDropped = 0;
+	device->eventsDropped = 0;
+	resetTouchFilter(&(device->filter));
+	initGestureRecognizer(&(device->recognizer), getActiveProfile, clickMode, CONTINUATION);
+	device->recognizer.easing = isEasingEnabled();
+	device->recognizer.smoothScrolling = canScrollSmoothly();
+}
+
+/* Opens the given touch device and starts reading from it.
+ * Returns 0 on success, -1 if the device is not available (yet). */
+int openTouchDevice(TouchDevice* device) {
+	if ((device->fileDesc = open(device->devName, O_RDONLY)) < 0) {
+		return -1;
+	}
+
+	/* Have the events timestamped on the clock we use for everything else */
+	int clockId = CLOCK_MONOTONIC;
+	device->kernelTimestamps = ioctl(device->fileDesc, EVIOCSCLOCKID, &clockId) == 0;
+	if(!device->kernelTimestamps) {
+		printf("Couldn't switch device to monotonic timestamps, timing frames on arrival.\n");
+	}
+
+	/* Read device name */
+	strcpy(device->name, "Unknown");
+	ioctl(device->fileDesc, EVIOCGNAME(sizeof(device->name)), device->name);
+	printf("Input device name: \"%s\"\n", device->name);
+
+	if(findXInputDevice(device) != 0) {
+		fprintf(stderr, "ERROR: Input device \"%s\" not found in XInput device list!\n", device->name);
+		close(device->fileDesc);
+		device->fileDesc = -1;
+		return -1;
+	}
+
+	/* We perform raw event reading here as X touch events don't seem too reliable */
+	if (initDecoder(&(device->decoder), device->fileDesc) != 0) {
+		fprintf(stderr, "ERROR: Couldn't allocate decoder\n");
+		exit(1);
+	}
+	if(debugMode) printf("Device has %i slots%s.\n", device->decoder.slotCount, device->decoder.useLegacyProtocol ? ", uses legacy protocol" : "");
+
+	if(recording) {
+		char data[sizeof(TraceDevice) + sizeof(device->name)];
+		TraceDevice traceDevice = { device->decoder.slotCount, device->decoder.useLegacyProtocol, device->kernelTimestamps };
+		memcpy(data, &traceDevice, sizeof(TraceDevice));
+		strcpy(data + sizeof(TraceDevice), device->name);
+		recordTrace(TRACE_DEVICE_OPENED, device, data, sizeof(TraceDevice) + strlen(device->name));
+	}
+
+	/* Prepare by reading calibration */
+	readCalibrationData(device);
+
+	/* Receive device property change events */
+	if(!disableOnGrab)
+	{
+		XIEventMask device_mask2;
+		unsigned char mask_data2[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		device_mask2.deviceid = device->deviceID;
+		device_mask2.mask_len = sizeof(mask_data2);
+		device_mask2.mask = mask_data2;
+		XISetMask(device_mask2.mask, XI_PropertyEvent);
+		XISetMask(device_mask2.mask, XI_ButtonPress);
+		XISelectEvents(display, root, &device_mask2, 1);
+	}
+
+	if(!passthrough) {
+		grab(display, device->deviceID);
+	}
+
+	resetTouchDevice(device);
+
+	if(watchTouchDevice(device) != 0) {
+		fprintf(stderr, "ERROR: Couldn't watch input device\n");
+		exit(1);
+	}
+
+	printf("Reading input from device %s ...\n", device->devName);
+	return 0;
+}
+
+/* Tries to open the touch devices that are not available at the moment */
+void openMissingDevices() {
+	int i;
+	for(i = 0; i < touchDeviceCount; i++) {
+		if(touchDevices[i].fileDesc < 0) {
+			openTouchDevice(&(touchDevices[i]));
+		}
+	}
+}
+
+/* Watches the directories of the device files, so that devices which have gone away
+ * are reopened as soon as their file is there again. Returns 0 on success. */
+int watchDeviceFiles() {
+	int i;
+	hotplugDesc = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(hotplugDesc < 0) {
+		return -1;
+	}
+
+	for(i = 0; i < touchDeviceCount; i++) {
+		TouchDevice* device = &(touchDevices[i]);
+		char dirName[256] = ".";
+		char* slash = strrchr(device->devName, '/');
+		if(slash != NULL) {
+			int length = slash - device->devName;
+			if(length == 0) length = 1;
+			if(length >= sizeof(dirName)) length = sizeof(dirName) - 1;
+			strncpy(dirName, device->devName, length);
+			dirName[length] = '\0';
+			device->fileName = slash + 1;
+		} else {
+			device->fileName = device->devName;
+		}
+
+		/* udev creates the file and fixes its permissions afterwards */
+		device->watchDesc = inotify_add_watch(hotplugDesc, dirName, IN_CREATE | IN_ATTRIB | IN_MOVED_TO);
+		if(device->watchDesc < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Watches the directory of the configuration file, so that the profiles are reloaded
+ * when it is saved. Returns 0 on success. */
+int watchConfigFile() {
+	char dirName[4096] = ".";
+	char* slash = strrchr(configFile, '/');
+	if(slash != NULL) {
+		int length = slash - configFile;
+		if(length == 0) length = 1;
+		if(length >= sizeof(dirName)) length = sizeof(dirName) - 1;
+		strncpy(dirName, configFile, length);
+		dirName[length] = '\0';
+		configFileName = slash + 1;
+	} else {
+		configFileName = configFile;
+	}
+
+	/* Editors either write the file or replace it */
+	configWatchDesc = inotify_add_watch(hotplugDesc, dirName, IN_CLOSE_WRITE | IN_MOVED_TO);
+	return configWatchDesc < 0 ? -1 : 0;
+}
+
+/* Something happened in one of the watched directories */
+void handleHotplug(int notifyDesc, void* data) {
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	int rd, i;
+
+	while((rd = read(notifyDesc, buffer, sizeof(buffer))) > 0) {
+		char* position = buffer;
+		while(position < buffer + rd) {
+			struct inotify_event* event = (struct inotify_event*) position;
+			position += sizeof(struct inotify_event) + event->len;
+
+			if(event->mask & IN_Q_OVERFLOW) {
+				openMissingDevices();
+				continue;
+			}
+			if(event->wd == configWatchDesc && event->len > 0 && strcmp(event->name, configFileName) == 0) {
+				if(debugMode) printf("%s changed.\n", configFile);
+				loadProfiles();
+			}
+			for(i = 0; i < touchDeviceCount; i++) {
+				TouchDevice* device = &(touchDevices[i]);
+				if(device->fileDesc < 0 && device->watchDesc == event->wd
+						&& event->len > 0 && strcmp(event->name, device->fileName) == 0) {
+					if(debugMode) printf("%s appeared.\n", device->devName);
+					openTouchDevice(device);
+				}
+			}
+		}
+	}
+}
+
+void handleEasingTimer(int timerDesc, void* data) {
+	easingTimerArmed = 0;
+	beginOutputBatch();
+	checkEasingStep();
+	endOutputBatch();
+	freeRetiredProfiles();
+}
+
+/* Arms the easing timer for the next easing step, or disarms it if easing has stopped.
+ * Only touches the timer if the deadline has changed. */
+void updateEasingTimer() {
+	TimeVal* deadline = getEasingDeadline();
+	if(deadline != NULL) {
+		if(!easingTimerArmed || timercmp(deadline, &easingTimerDeadline, !=)) {
+			easingTimerDeadline = *deadline;
+			easingTimerArmed = 1;
+			setLoopTimer(easingTimerDesc, deadline);
+		}
+	} else if(easingTimerArmed) {
+		easingTimerArmed = 0;
+		setLoopTimer(easingTimerDesc, NULL);
+	}
+}
+
+/* Performs the easing steps that are due up to the given time of the trace being replayed */
+void replayEasingUntil(TimeVal time) {
+	TimeVal* deadline;
+	while((deadline = getEasingDeadline()) != NULL && !timercmp(deadline, &time, >)) {
+		replayTime = *deadline;
+		beginOutputBatch();
+		checkEasingStep();
+		endOutputBatch();
 	}
 }
 
+/* Feeds a recorded trace through the decoder and the gesture recognition. Time follows the
+ * timestamps of the trace, so delays and easing behave as they did while recording, but
+ * nothing waits for them. Output goes to the output sink. Returns 0 on success. */
+int replayTrace(char* fileName) {
+	static struct input_event ev[TRACE_MAX_PAYLOAD / sizeof(TraceEvent)];
+	TraceRecord* record = malloc(sizeof(TraceRecord));
+	long records = 0, frames = 0;
+	TimeVal firstTime = { 0, 0 };
+	int result;
+
+	if (record == NULL || openTraceForReading(&trace, fileName) != 0) {
+		fprintf(stderr, "ERROR: Couldn't read trace %s\n", fileName);
+		return 1;
+	}
+	replaying = 1;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while ((result = readTraceRecord(&trace, record)) > 0) {
+		if(records == 0) firstTime = record->time;
+		records++;
+
+		replayEasingUntil(record->time);
+		replayTime = record->time;
+
+		if(record->device >= MAX_TOUCH_DEVICES) continue;
+		TouchDevice* device = &(touchDevices[record->device]);
+
+		switch(record->type) {
+		case TRACE_DEVICE_OPENED:
+			if(record->length < sizeof(TraceDevice)) break;
+			TraceDevice* traceDevice = (TraceDevice*) record->data;
+			if(device->decoder.slots != NULL) freeDecoder(&(device->decoder));
+			if(record->device >= touchDeviceCount) touchDeviceCount = record->device + 1;
+			strncpy(device->name, (char*) record->data + sizeof(TraceDevice), sizeof(device->name) - 1);
+			device->fileDesc = -1;
+			device->kernelTimestamps = traceDevice->kernelTimestamps;
+			if(initDecoderWithLayout(&(device->decoder), traceDevice->slotCount, traceDevice->useLegacyProtocol) != 0) {
+				fprintf(stderr, "ERROR: Couldn't allocate decoder\n");
+				exit(1);
+			}
+			initTouchFilter(&(device->filter), &filterSettings);
+			resetTouchDevice(device);
+			if(debugMode) printf("Device %i: \"%s\", %i slots\n", record->device, device->name, device->decoder.slotCount);
+			break;
+		case TRACE_DEVICE_CLOSED:
+			if(device->decoder.slots != NULL) {
+				if(device->fingersWereDown > 0) {
+					cancelGesture(device, replayTime);
+				}
+				freeDecoder(&(device->decoder));
+			}
+			break;
+		case TRACE_CALIBRATION:
+			if(record->length < sizeof(TraceCalibration)) break;
+			TraceCalibration* calibration = (TraceCalibration*) record->data;
+			device->calibMinX = calibration->minX;
+			device->calibMaxX = calibration->maxX;
+			device->calibMinY = calibration->minY;
+			device->calibMaxY = calibration->maxY;
+			device->calibSwapX = calibration->swapX;
+			device->calibSwapY = calibration->swapY;
+			device->calibSwapAxes = calibration->swapAxes;
+			device->calibMatrixUse = calibration->matrixUse;
+			memcpy(device->calibMatrix, calibration->matrix, sizeof(device->calibMatrix));
+			break;
+		case TRACE_SCREEN_SIZE:
+			if(record->length < 2 * sizeof(int32_t)) break;
+			screenWidth = ((int32_t*) record->data)[0];
+			screenHeight = ((int32_t*) record->data)[1];
+			break;
+		case TRACE_BLOCKING_INPUT:
+			/* There is no X device while replaying, any id other than -1 enables blocking */
+			blockingDeviceID = 0;
+			lastBlockingInputTime = replayTime;
+			break;
+		case TRACE_EVENTS:
+			if(device->decoder.slots != NULL) {
+				frames += processDeviceEvents(device, ev, decodeTraceEvents(record, ev, sizeof(ev) / sizeof(ev[0])));
+			}
+			break;
+		}
+	}
+
+	/* Let easing run out */
+	TimeVal* deadline;
+	while((deadline = getEasingDeadline()) != NULL) {
+		replayTime = *deadline;
+		beginOutputBatch();
+		checkEasingStep();
+		endOutputBatch();
+	}
+	releaseButton();
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if(result < 0) {
+		fprintf(stderr, "WARNING: Trace is truncated\n");
+	}
+	printf("Replayed %li records, %li frames, %i s of input in %.1f ms\n", records, frames,
+			timeDiff(firstTime, replayTime) / 1000,
+			(end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+	printOutputStatistics();
+	printDeviceFilterStatistics();
+
+	closeTrace(&trace);
+	free(record);
+	return 0;
+}
+
 /* Main function, contains kernel driver event loop */
 int main(int argc, char **argv) {
 
-	char* devname = 0;
 	int doDaemonize = 1;
 	int doWait = 0;
-	int clickMode = 2;
 	int justVersion = 0;
-
-	char* blockingDevName = 0;
+	char* recordFileName = NULL;
+	char* replayFileName = NULL;
+	char* outputName = NULL;
+	char* outputArgument = NULL;
 
 	int i;
 	for (i = 1; i < argc; i++) {
@@ -943,6 +1893,27 @@ int main(int argc, char **argv) {
 			if(i + 1 < argc) {
 				blockingIntervalMilliseconds = atoi(argv[++i]);
 			}
+		} else if (strcmp(argv[i], "--record") == 0) {
+			if(i + 1 < argc) {
+				recordFileName = argv[++i];
+			}
+		} else if (strcmp(argv[i], "--replay") == 0) {
+			if(i + 1 < argc) {
+				replayFileName = argv[++i];
+			}
+		} else if (strncmp(argv[i], "--output=", 9) == 0) {
+			outputName = argv[i] + 9;
+			char* colon = strchr(outputName, ':');
+			if(colon != NULL) {
+				*colon = '\0';
+				outputArgument = colon + 1;
+			}
+		} else if (strcmp(argv[i], "--config") == 0) {
+			if(i + 1 < argc) {
+				configFile = argv[++i];
+			}
+		} else if (strcmp(argv[i], "--smooth-scroll") == 0) {
+			smoothScrolling = 1;
 		} else if (strcmp(argv[i], "--moveback") == 0) {
 			moveMouseBackAfterTouches = 1;
 		} else if (strcmp(argv[i], "--screenpad") == 0) {
@@ -950,8 +1921,26 @@ int main(int argc, char **argv) {
 			disableOnGrab = 1;
 			alsoBlockTwoFingerTouches = 1;
 			moveMouseBackAfterTouches = 1;
+		} else if (strcmp(argv[i], "--filter") == 0) {
+			filterSettings.enabled = 1;
+		} else if (strncmp(argv[i], "--filter=", 9) == 0) {
+			if(parseFilterSettings(argv[i] + 9, &filterSettings) != 0) {
+				fprintf(stderr, "ERROR: Invalid filter \"%s\", expected MINCUTOFF,BETA[,DCUTOFF]\n", argv[i] + 9);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--no-filter") == 0) {
+			filterSettings.enabled = 0;
+			filterSettings.predict = 0;
+		} else if (strncmp(argv[i], "--predict=", 10) == 0) {
+			/* Prediction extrapolates along the filtered velocity */
+			filterSettings.predict = atoi(argv[i] + 10);
+			if(filterSettings.predict > 0) filterSettings.enabled = 1;
+		} else if (touchDeviceCount < MAX_TOUCH_DEVICES) {
+			/* Filter options given so far apply to this device */
+			initTouchFilter(&(touchDevices[touchDeviceCount].filter), &filterSettings);
+			touchDevices[touchDeviceCount++].devName = argv[i];
 		} else {
-			devname = argv[i];
+			fprintf(stderr, "WARNING: Only %i devices supported, ignoring %s\n", MAX_TOUCH_DEVICES, argv[i]);
 		}
 	}
 
@@ -965,13 +1954,46 @@ int main(int argc, char **argv) {
 		return 0;
 	}
 
-	initGestures(clickMode);
+	initGestures();
+	if (configFile == NULL) {
+		configFile = findConfigFile();
+	}
+	configCacheFile = getConfigCacheFile();
+
+	if (outputName != NULL) {
+		output = findOutputSink(outputName);
+		if (output == NULL) {
+			fprintf(stderr, "ERROR: Unknown output \"%s\"\n", outputName);
+			return 1;
+		}
+	} else if (replayFileName != NULL) {
+		output = &nullSink;
+	}
+
+	if (replayFileName != NULL) {
+		if (output->needsDisplay || output->open(NULL, outputArgument) != 0) {
+			fprintf(stderr, "ERROR: Can't use output \"%s\" for replaying\n", output->name);
+			return 1;
+		}
+		loadProfiles();
+		compileProfileActions();
+		int result = replayTrace(replayFileName);
+		output->close();
+		return result;
+	}
 
 	if (blockingDevName != 0)
 	{
 		lastBlockingInputTime = getCurrentTime();
 	}
 
+	if (recordFileName != NULL) {
+		if (openTraceForWriting(&trace, recordFileName) != 0) {
+			perror(recordFileName);
+			return 1;
+		}
+		recording = 1;
+	}
 
 	if (doDaemonize) {
 		daemonize();
@@ -983,12 +2005,30 @@ int main(int argc, char **argv) {
 	}
 
 
+	/* The output thread uses Xlib as well */
+	XInitThreads();
+
 	/* Connect to X server */
 	if ((display = XOpenDisplay(NULL)) == NULL) {
 		fprintf(stderr, "ERROR: Couldn't connect to X server\n");
 		exit(1);
 	}
 
+	/* The output gets a connection of its own, so it doesn't hold up the one we read the
+	   window and device events from */
+	outputDisplay = display;
+	if (output->needsDisplay && (outputDisplay = XOpenDisplay(NULL)) == NULL) {
+		fprintf(stderr, "ERROR: Couldn't connect to X server\n");
+		exit(1);
+	}
+
+	if (output->open(outputDisplay, outputArgument) != 0) {
+		fprintf(stderr, "ERROR: Couldn't open output \"%s\"\n", output->name);
+		exit(1);
+	}
+	loadProfiles();
+	compileProfileActions();
+
 	/* Read X data */
 	screenNum = DefaultScreen(display);
 
@@ -998,379 +2038,205 @@ int main(int argc, char **argv) {
 //	realDisplayHeight = DisplayHeight(display, screenNum);
 
 	WM_CLASS = XInternAtom(display, "WM_CLASS", 0);
+	NET_ACTIVE_WINDOW = XInternAtom(display, "_NET_ACTIVE_WINDOW", 0);
+
+	/* Get notified about new windows and focus changes */
+	XSelectInput(display, root, StructureNotifyMask | SubstructureNotifyMask | PropertyChangeMask | FocusChangeMask);
+
+	/* Track the active window if the window manager announces it */
+	Atom actualType;
+	int actualFormat;
+	unsigned long itemCount, bytesAfter;
+	unsigned char* propertyData = NULL;
+	if(XGetWindowProperty(display, root, NET_ACTIVE_WINDOW, 0, 1, False, AnyPropertyType, &actualType,
+			&actualFormat, &itemCount, &bytesAfter, &propertyData) == Success && actualType != None) {
+		activeWindowTracked = 1;
+	}
+	if(propertyData != NULL) XFree(propertyData);
 
-	/* Get notified about new windows */
-	XSelectInput(display, root, StructureNotifyMask | SubstructureNotifyMask);
+	/* Mirror the window tree, so we don't have to ask the server when walking it */
+	if(initWindowTree(display, root) != 0) {
+		fprintf(stderr, "WARNING: Couldn't mirror the window tree\n");
+	}
+	updateActiveWindow();
 
-	//TODO load blacklist and profiles from file(s)
+	/* Device file names */
+	if (touchDeviceCount == 0) {
+		touchDevices[touchDeviceCount++].devName = "/dev/twofingtouch";
+	}
 
-	/* Device file name */
-	if (devname == 0) {
-		devname = "/dev/twofingtouch";
+	/* Check that we can read from the device files */
+	for (i = 0; i < touchDeviceCount; i++) {
+		int fileDesc;
+		if ((fileDesc = open(touchDevices[i].devName, O_RDONLY)) < 0) {
+			perror(touchDevices[i].devName);
+			return 1;
+		}
+		close(fileDesc);
+		touchDevices[i].fileDesc = -1;
 	}
 
-	/* Try to read from device file */
-	int fileDesc;
-	if ((fileDesc = open(devname, O_RDONLY)) < 0) {
-		perror("/dev/twofingtouch");
+
+	if (initEventLoop(&eventLoop) != 0) {
+		perror("epoll");
 		return 1;
 	}
 
-
+	/* Signals are received through the event loop */
 	sigemptyset(&signalSet);
 	sigaddset(&signalSet, SIGINT);
 	sigaddset(&signalSet, SIGTERM);
+	sigaddset(&signalSet, SIGHUP);
 	pthread_sigmask (SIG_BLOCK, &signalSet, NULL);
-	if(pthread_create(&signalThread, NULL, signalThreadFunction, NULL)) {
-		printf("Couldn't create signal thread.\n");
+	int signalDesc = signalfd(-1, &signalSet, SFD_CLOEXEC);
+	if(signalDesc < 0 || addLoopSource(&eventLoop, signalDesc, handleSignal, NULL) != 0) {
+		printf("Couldn't set up signal handling.\n");
 	}
 
+	int eventQueueDesc = XConnectionNumber(display);
+	if(addLoopSource(&eventLoop, eventQueueDesc, handleXEvents, NULL) != 0) {
+		fprintf(stderr, "ERROR: Couldn't watch X connection\n");
+		exit(1);
+	}
 
-	fd_set fileDescSet;
-	FD_ZERO(&fileDescSet);
-
-	int eventQueueDesc = XConnectionNumber(display);	
-
-	while (1) {
-		/* Perform initialization at beginning and after module has been re-loaded */
-		int rd, i;
-		struct input_event ev[64];
-
-		char name[256] = "Unknown";
+	/* Started with all signals of signalSet blocked, so the threads don't take them */
+	if((output = startOutputThread(output)) == NULL || startInputThread(&eventLoop, handleInputFrame) != 0) {
+		fprintf(stderr, "ERROR: Couldn't start threads\n");
+		exit(1);
+	}
 
-		/* Read device name */
-		ioctl(fileDesc, EVIOCGNAME(sizeof(name)), name);
-		printf("Input device name: \"%s\"\n", name);
+	easingTimerDesc = createLoopTimer(&eventLoop, handleEasingTimer, NULL);
+	if(easingTimerDesc < 0) {
+		fprintf(stderr, "ERROR: Couldn't create easing timer\n");
+		exit(1);
+	}
 
-		/* Look if a mapping is available and, if yes, map calibration device name */
-		char calibrateName[256];
-		strcpy(calibrateName, name);
-		for(i = 0; mapDeviceNameForCalibration[i].origDeviceName != NULL; i++)
-		{
-			if(strcmp(name, mapDeviceNameForCalibration[i].origDeviceName) == 0)
-			{
-				strcpy(calibrateName, mapDeviceNameForCalibration[i].mappedDeviceName);
-				printf("For calibration: \"%s\"\n", calibrateName);
-				break;
-			}
-		}
+	passthroughTimerDesc = createLoopTimer(&eventLoop, handlePassthroughTimer, NULL);
+	if(passthroughTimerDesc < 0) {
+		fprintf(stderr, "ERROR: Couldn't create passthrough timer\n");
+		exit(1);
+	}
+	updatePassthrough();
 
-		//TODO activate again?
-		//XSetErrorHandler(invalidWindowHandler);
+	if(watchDeviceFiles() != 0 || addLoopSource(&eventLoop, hotplugDesc, handleHotplug, NULL) != 0) {
+		perror("inotify");
+		exit(1);
+	}
+	if(configFile != NULL && watchConfigFile() != 0) {
+		fprintf(stderr, "WARNING: Couldn't watch %s\n", configFile);
+	}
 
 
-		int opcode;
-		if (!XQueryExtension(display, "RANDR", &opcode, &randrEvBase,
-				&randrErrBase)) {
-			fprintf(stderr, "ERROR: X RANDR extension not available.\n");
-			XCloseDisplay(display);
-			exit(1);
-		}
+	int opcode;
+	if (!XQueryExtension(display, "RANDR", &opcode, &randrEvBase,
+			&randrErrBase)) {
+		fprintf(stderr, "ERROR: X RANDR extension not available.\n");
+		XCloseDisplay(display);
+		exit(1);
+	}
 
-		/* Which version of XRandR? We support 1.3 */
-		int major = 1, minor = 3;
-		if (!XRRQueryVersion(display, &major, &minor)) {
-			fprintf(stderr, "ERROR: XRandR version not available.\n");
-			XCloseDisplay(display);
-			exit(1);
-		} else if(!(major>1 || (major == 1 && minor >= 3))) {
-			fprintf(stderr, "ERROR: XRandR 1.3 not available. Server supports %d.%d\n", major, minor);
-			XCloseDisplay(display);
-			exit(1);
-		}
+	/* Which version of XRandR? We support 1.3 */
+	int major = 1, minor = 3;
+	if (!XRRQueryVersion(display, &major, &minor)) {
+		fprintf(stderr, "ERROR: XRandR version not available.\n");
+		XCloseDisplay(display);
+		exit(1);
+	} else if(!(major>1 || (major == 1 && minor >= 3))) {
+		fprintf(stderr, "ERROR: XRandR 1.3 not available. Server supports %d.%d\n", major, minor);
+		XCloseDisplay(display);
+		exit(1);
+	}
 
-		/* XInput Extension available? */
-		if (!XQueryExtension(display, "XInputExtension", &opcode, &xinputEvBase,
-				&xinputErrBase)) {
-			fprintf(stderr, "ERROR: X Input extension not available.\n");
-			XCloseDisplay(display);
-			exit(1);
-		}
+	/* XInput Extension available? */
+	if (!XQueryExtension(display, "XInputExtension", &opcode, &xinputEvBase,
+			&xinputErrBase)) {
+		fprintf(stderr, "ERROR: X Input extension not available.\n");
+		XCloseDisplay(display);
+		exit(1);
+	}
 
-		/* Which version of XI2? We support 2.1 */
-		major = 2; minor = 1;
-		if (XIQueryVersion(display, &major, &minor) == BadRequest) {
-			fprintf(stderr, "ERROR: XI 2.1 not available. Server supports %d.%d\n", major, minor);
-			XCloseDisplay(display);
-			exit(1);
-		}
+	/* Which version of XI2? We support 2.1 */
+	major = 2; minor = 1;
+	if (XIQueryVersion(display, &major, &minor) == BadRequest) {
+		fprintf(stderr, "ERROR: XI 2.1 not available. Server supports %d.%d\n", major, minor);
+		XCloseDisplay(display);
+		exit(1);
+	}
 
-		screenWidth = XDisplayWidth(display, screenNum);
-		screenHeight = XDisplayHeight(display, screenNum);
+	screenWidth = XDisplayWidth(display, screenNum);
+	screenHeight = XDisplayHeight(display, screenNum);
+	recordScreenSize();
+
+	/* Recieve events when screen size changes */
+	XRRSelectInput(display, root, RRScreenChangeNotifyMask);
+
+	/* Receive events when input devices are added, a device file may be there before
+	   X knows the device */
+	XIEventMask hierarchyMask;
+	unsigned char hierarchyMaskData[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	hierarchyMask.deviceid = XIAllDevices;
+	hierarchyMask.mask_len = sizeof(hierarchyMaskData);
+	hierarchyMask.mask = hierarchyMaskData;
+	XISetMask(hierarchyMask.mask, XI_HierarchyChanged);
+	XISelectEvents(display, root, &hierarchyMask, 1);
+
+	if(blockingDevName != 0) {
+		findBlockingDevice();
+	}
 
-		int n;
-		XIDeviceInfo *info = XIQueryDevice(display, XIAllDevices, &n);
-		if (!info) {
-			fprintf(stderr, "ERROR: No XInput devices available\n");
-			exit(1);
-		}
+	/* Needed for XTest to work correctly */
+	XTestGrabControl(outputDisplay, True);
 
-		/* Go through input devices and look for that with the same name as the given device */
-		deviceID = -1;
-		calibrateDeviceID = -1;
-		blockingDeviceID = -1;
-		int devindex;
-		for(devindex = 0; devindex < n; devindex++) {
-			if(info[devindex].use == XIMasterPointer 
-			   || info[devindex].use == XIMasterKeyboard
-			   || info[devindex].use == XISlaveKeyboard)
-				continue;
+	/* Needed for some reason to receive events */
+/*	XGrabPointer(display, root, False, 0, GrabModeAsync, GrabModeAsync,
+			None, None, CurrentTime);
+	XUngrabPointer(display, CurrentTime);*/
 
-			if(strcmp(info[devindex].name, name) == 0 && deviceID == -1) {
-				deviceID = info[devindex].deviceid;
-			}
-			if(strcmp(info[devindex].name, calibrateName) == 0 && calibrateDeviceID == -1) {
-				calibrateDeviceID = info[devindex].deviceid;
-			}
-			if(blockingDevName != 0 && strcmp(info[devindex].name, blockingDevName) == 0 && blockingDeviceID == -1) {
-				blockingDeviceID = info[devindex].deviceid;
-			}
-		}
-		if(deviceID == -1) {
-			fprintf(stderr, "ERROR: Input device not found in XInput device list!\n");
+	for (i = 0; i < touchDeviceCount; i++) {
+		if (openTouchDevice(&(touchDevices[i])) != 0) {
 			exit(1);
 		}
-		if(calibrateDeviceID == -1) {
-			printf("Using default device for calibration\n");
-			calibrateDeviceID = deviceID;
-		}
-		if(blockingDevName != 0) {
-			if(blockingDeviceID == -1) {
-				printf("WARNING: Blocking device \"%s\" not found in XInput device list!\n", blockingDevName);
-			} else {
-				printf("Blocking on device %i.\n", blockingDeviceID);
-			}
-		}
-
-		XIFreeDeviceInfo(info);
-
-		if(debugMode) printf("XInput device id is %i.\n", deviceID);
-		if(debugMode) printf("XInput device id for calibration is %i.\n", calibrateDeviceID);
-
-		/* Prepare by reading calibration */
-		readCalibrationData(1, name);
+	}
 
+	printf("Reading input from %i device%s ... (interrupt to exit)\n", touchDeviceCount, touchDeviceCount == 1 ? "" : "s");
 
-		/* Receive device property change events */
-		if(!disableOnGrab)
-		{
-			XIEventMask device_mask2;
-			unsigned char mask_data2[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-			device_mask2.deviceid = deviceID;
-			device_mask2.mask_len = sizeof(mask_data2);
-			device_mask2.mask = mask_data2;
-			XISetMask(device_mask2.mask, XI_PropertyEvent);
-			XISetMask(device_mask2.mask, XI_ButtonPress);
-			//XISetMask(device_mask2.mask, XI_TouchBegin);
-			//XISetMask(device_mask2.mask, XI_TouchUpdate);
-			//XISetMask(device_mask2.mask, XI_TouchEnd);
-			XISelectEvents(display, root, &device_mask2, 1);
+	/* Devices that go away (probably because the module has been unloaded or the
+	   system was suspended) are reopened as soon as they are back. */
+	while (!stopSignalReceived) {
+		/* Xlib may have read events into its queue while we were doing other
+		   requests; those won't make the connection readable again. */
+		while(XEventsQueued(display, QueuedAlready) > 0) {
+			handleXEvent();
 		}
-
-		/* Recieve events when screen size changes */
-		XRRSelectInput(display, root, RRScreenChangeNotifyMask);
-
-		/* Receive events from blocking device */
-		if(blockingDeviceID != -1)
-		{
-			XIEventMask device_mask3;
-			unsigned char mask_data3[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-			device_mask3.deviceid = blockingDeviceID;
-			device_mask3.mask_len = sizeof(mask_data3);
-			device_mask3.mask = mask_data3;
-			XISetMask(device_mask3.mask, XI_ButtonPress);
-			XISetMask(device_mask3.mask, XI_Motion);
-			XISelectEvents(display, root, &device_mask3, 1);
+		processPendingWindows();
+		updateEasingTimer();
+		if(recording) {
+			flushTrace(&trace);
 		}
 
-
-		/* Receive touch events */
-
-		/* Needed for XTest to work correctly */
-		XTestGrabControl(display, True);
-
-		/* Needed for some reason to receive events */
-/*		XGrabPointer(display, root, False, 0, GrabModeAsync, GrabModeAsync,
-				None, None, CurrentTime);
-		XUngrabPointer(display, CurrentTime);*/
-
-		grab(display, deviceID);		
-
-		printf("Reading input from device ... (interrupt to exit)\n");
-
-		/* We perform raw event reading here as X touch events don't seem too reliable */
-		int currentSlot = 0;
-
-		/* If we use the legacy protocol, we collect all data of one finger into tempFingerInfo and set
-		   it to the correct slot once MT_SYNC occurs. */
-		FingerInfo tempFingerInfo = { .rawX=0, .rawY=0, .rawZ=0, .id = -1, .slotUsed = 0, .setThisTime = 0 };
-
-		while (1) {
-			if (stopSignalReceived)
-			{
-				break;
-			}
-
-
-			FD_SET(fileDesc, &fileDescSet);
-			FD_SET(eventQueueDesc, &fileDescSet);
-
-			TimeVal timeVal; 
-			memcpy(&timeVal, getEasingStepTimeVal(), sizeof(TimeVal));
-			select(MAX(fileDesc, eventQueueDesc) + 1, &fileDescSet, NULL, NULL, &timeVal);
-			
-			checkEasingStep();
-
-			if(FD_ISSET(fileDesc, &fileDescSet))
-			{
-
-
-				rd = read(fileDesc, ev, sizeof(struct input_event) * 64);
-				if (rd < (int) sizeof(struct input_event)) {
-					printf("Data stream stopped\n");
-					break;
-				}
-				for (i = 0; i < rd / sizeof(struct input_event); i++) {
-
-					if (ev[i].type == EV_SYN) {
-						if (0 == ev[i].code) { // Ev_Sync event end
-							/* All finger data received, so process now. */
-
-							if(useLegacyProtocol) {
-								/* Clear slots not set this time */
-								int i;
-								for(i = 0; i < 2; i++) {
-									if(fingerInfos[i].setThisTime) {
-										fingerInfos[i].setThisTime = 0;
-									} else {
-										/* Clear slot */
-										fingerInfos[i].slotUsed = 0;
-									}
-								}
-								tempFingerInfo.slotUsed = 0;
-							}
-
-							processFingers();
-
-						} else if (2 == ev[i].code) { // MT_Sync : Multitouch event end
-
-							if(!useLegacyProtocol) {
-
-								/* This messsage indicates we use legacy protocol, so switch */
-								useLegacyProtocol = 1;
-								currentSlot = -1;
-								tempFingerInfo.slotUsed = 0;
-								if(debugMode) printf("Switch to legacy protocol.\n");
-							} else {
-								if(tempFingerInfo.slotUsed) {
-									/* Finger info for one finger collected in tempFingerInfo, so save it to fingerInfos. */
-
-									/* Look for slot to put the data into by looking at the tracking ids */
-									int index = -1;
-									int i;
-									for(i = 0; i < 2; i++) {
-										if(fingerInfos[i].slotUsed && fingerInfos[i].id == tempFingerInfo.id) {
-											index = i;
-											break;
-										}
-									}
-							
-									if(index == -1) {
-										for(i = 0; i < 2; i++) {
-											if(!fingerInfos[i].slotUsed) {
-												/* "Empty" slot, so we can add it. */
-												index = i;
-												fingerInfos[i].id = tempFingerInfo.id;
-												fingerInfos[i].slotUsed = 1;
-												break;
-											}
-										}
-									}
-
-									if(index != -1) {
-										/* Copy temporary data to slot */
-										fingerInfos[index].setThisTime = 1;
-										fingerInfos[index].rawX = tempFingerInfo.rawX;
-										fingerInfos[index].rawY = tempFingerInfo.rawY;
-										fingerInfos[index].rawZ = tempFingerInfo.rawZ;
-									}
-								}
-							}
-						}
-
-					} else if (ev[i].type == EV_MSC && (ev[i].code == MSC_RAW
-							|| ev[i].code == MSC_SCAN)) {
-					} else if (ev[i].code == 47) {
-						currentSlot = ev[i].value;
-						if(currentSlot < 0 || currentSlot > 1) currentSlot = -1;
-					} else {
-						/* Set finger info values for current finger */
-						if (ev[i].code == 57) {
-							/* ABS_MT_TRACKING_ID */
-							if(currentSlot != -1) {
-								if(ev[i].value == -1)
-								{
-									fingerInfos[currentSlot].slotUsed = 0;
-								}
-								else
-								{
-									fingerInfos[currentSlot].id = ev[i].value;
-									fingerInfos[currentSlot].slotUsed = 1;
-								}
-							} else if(useLegacyProtocol) {
-								tempFingerInfo.id = ev[i].value;
-								tempFingerInfo.slotUsed = 1;
-							}
-						};
-						if (ev[i].code == 53) {
-							if(currentSlot != -1) {
-								fingerInfos[currentSlot].rawX = ev[i].value;
-							} else if(useLegacyProtocol) {
-								tempFingerInfo.rawX = ev[i].value;
-							}
-						};
-						if (ev[i].code == 54) {
-							if(currentSlot != -1) {
-								fingerInfos[currentSlot].rawY = ev[i].value;
-							} else if(useLegacyProtocol) {
-								tempFingerInfo.rawY = ev[i].value;
-							}
-						};
-						if (ev[i].code == 58) {
-							if(currentSlot != -1) {
-								fingerInfos[currentSlot].rawZ = ev[i].value;
-							} else if(useLegacyProtocol) {
-								tempFingerInfo.rawZ = ev[i].value;
-							}
-						};
-					}
-				}
-
-			}
-
-			if(FD_ISSET(eventQueueDesc, &fileDescSet)) {
-				handleXEvent();
-			}
-		}
-
-		/* Stream stopped, probably because module has been unloaded */
-		close(fileDesc);
-
-		/* Clean up */
-		releaseButton();
-		ungrab(display, deviceID);
-
-		if (stopSignalReceived)
-		{
+		if (runEventLoop(&eventLoop) != 0) {
+			perror("epoll_wait");
 			break;
 		}
+	}
 
-		/* Wait until device file is there again */
-		while ((fileDesc = open(devname, O_RDONLY)) < 0) {
-			sleep(1);
+	stopInputThread();
+	for (i = 0; i < touchDeviceCount; i++) {
+		if (touchDevices[i].fileDesc >= 0) {
+			closeTouchDevice(&(touchDevices[i]));
 		}
 	}
+	releaseButton();
+	closeTrace(&trace);
+	if(debugMode) {
+		printOutputStatistics();
+		printDeviceFilterStatistics();
+	}
+	/* Waits for the output thread to send what is left */
+	output->close();
 
+	if(outputDisplay != display) {
+		XCloseDisplay(outputDisplay);
+	}
 	XCloseDisplay(display);
 }
-
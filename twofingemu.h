@@ -21,31 +21,44 @@
 
 #define VERSION "0.1.6.20230112"
 
+#include <sys/time.h>
+#include "decoder.h"
+#include "filter.h"
+
 #define BLOCKING_INTERVAL_MS_DEFAULT 500
 
-typedef struct FingerInfo FingerInfo;
+/* Time the focus has to stay on or off a blacklisted window before the devices are
+ * ungrabbed or grabbed again */
+#define PASSTHROUGH_DELAY_MS 300
+
 typedef struct Action Action;
+typedef struct ActionStep ActionStep;
 typedef struct Profile Profile;
 
-struct FingerInfo {
-	int x;
-	int y;
-	int rawX;
-	int rawY;
-	int rawZ;
-	int slotUsed;
-	int setThisTime; /* For legacy protocol */
-	int id; /* Tracking ID */
+#define ACTIONSTEP_KEY 0
+#define ACTIONSTEP_BUTTON 1
+
+/* Press and release of up to four modifiers and the key or button */
+#define MAX_ACTION_STEPS 10
+
+/* A single key or button event of an action, with the code the output expects */
+struct ActionStep {
+	short type;
+	short press;
+	int code;
 };
 
 struct Action {
 	int actionType;
 	int keyButton;
 	int modifier;
-};
 
-void startEasingThread();
-void stopEasingThread();
+	/* Compiled by compileAction(): the events to send, the first pressSteps of them
+	   for the press, the rest for the release */
+	int stepCount;
+	int pressSteps;
+	ActionStep steps[MAX_ACTION_STEPS];
+};
 
 #define MODIFIER_SHIFT 1
 #define MODIFIER_CONTROL 2
@@ -53,35 +66,60 @@ void stopEasingThread();
 #define MODIFIER_SUPER 8
 
 struct Profile {
-	char* windowClass;
+	/* Thresholds and steps, read on every frame of a gesture, kept together */
+	int scrollMinDistance;
+	int hscrollStep;
+	int vscrollStep;
+	int scrollEasing;
+	/* Milliseconds in which easing slows down to 1/e of the speed */
+	int scrollEasingDecay;
+	int zoomMinDistance;
+	int rotateMinDistance;
+	int swipeMinDistance;
+	double zoomMinFactor;
+	double zoomStep;
+	double rotateMinAngle;
+	double rotateStep;
+	/* Derived from the above when the profile is put in use, so that the checks on every
+	   frame need neither square roots nor trigonometry */
+	double zoomMinFactorSquared;
+	double zoomStepSquared;
+	double zoomStepLog;
+	double rotateMinAngleCos;
+	double rotateStepCos;
+	double rotateStepSin;
 
-	int scrollInherit;
+	Action scrollBraceAction;
 	Action scrollDownAction;
 	Action scrollUpAction;
 	Action scrollLeftAction;
 	Action scrollRightAction;
-	Action scrollBraceAction;
-	int hscrollStep;
-	int vscrollStep;
-	int scrollMinDistance;
-	int scrollEasing;
-
-	int zoomInherit;
 	Action zoomInAction;
 	Action zoomOutAction;
-	double zoomStep;
-	int zoomMinDistance;
-	double zoomMinFactor;
-
-	int rotateInherit;
 	Action rotateLeftAction;
 	Action rotateRightAction;
-	double rotateStep;
-	int rotateMinDistance;
-	double rotateMinAngle;
 
-	int tapInherit;
+	/* Swipes with three or four fingers */
+	Action swipe3UpAction;
+	Action swipe3DownAction;
+	Action swipe3LeftAction;
+	Action swipe3RightAction;
+	Action swipe4UpAction;
+	Action swipe4DownAction;
+	Action swipe4LeftAction;
+	Action swipe4RightAction;
+
 	Action tapAction;
+
+	/* Groups of settings taken from the default profile. Profiles in use have been
+	   resolved: the settings have been copied in and the flags are cleared. */
+	int scrollInherit;
+	int zoomInherit;
+	int rotateInherit;
+	int swipeInherit;
+	int tapInherit;
+
+	char* windowClass;
 };
 
 #define ACTIONTYPE_NONE 0
@@ -97,40 +135,255 @@ struct Profile {
 #define GESTURE_SCROLL 2
 #define GESTURE_ZOOM 3
 #define GESTURE_ROTATE 4
+#define GESTURE_SWIPE 5
+
+typedef struct timeval TimeVal;
+
+typedef struct GestureRecognizer GestureRecognizer;
+typedef struct ScrollSample ScrollSample;
+typedef struct GestureOutput GestureOutput;
+typedef struct GestureTransition GestureTransition;
+typedef struct TouchDevice TouchDevice;
+
+/* Continuation mode -- when 1, two finger gesture is continued when one finger is released. */
+#define CONTINUATION 1
+
+/* What a recognizer wants to be done */
+#define GESTUREOUTPUT_ACTION 0 /* executeAction(action, what), z times */
+#define GESTUREOUTPUT_MOVE 1 /* movePointer(x, y, z) */
+#define GESTUREOUTPUT_PRESS 2 /* pressButton() */
+#define GESTUREOUTPUT_RELEASE 3 /* releaseButton() */
+#define GESTUREOUTPUT_SCROLL 4 /* scrollSmoothly(x, y) */
+#define GESTUREOUTPUT_START_EASING 5 /* startEasing(profile, x, y), speeds in pixels per second */
+#define GESTUREOUTPUT_STOP_EASING 6 /* stopEasing() */
+
+/* Most outputs of a single frame */
+#define MAX_GESTURE_OUTPUTS 32
+
+struct GestureOutput {
+	int type;
+	int what;
+	int x, y, z;
+	Action* action;
+	Profile* profile;
+};
+
+/* Position of the center between the fingers at the time of a frame */
+struct ScrollSample {
+	TimeVal time;
+	int x, y;
+};
+
+/* Number of center positions kept for the speed at the end of a scroll gesture */
+#define SCROLL_SAMPLES 16
+
+/* State of a touch, which decides what the next frame means */
+#define TOUCH_IDLE 0 /* No fingers on */
+#define TOUCH_SINGLE 1 /* One finger on, no second one yet */
+#define TOUCH_TWO 2 /* Two-finger gesture, maybe continued with one finger */
+#define TOUCH_AFTER_TWO 3 /* Two-finger gesture is over, a finger is still on */
+#define TOUCH_SWIPE 4 /* Three or four fingers are or were on */
+#define TOUCH_STATES 5
+
+/* Columns of the transition table: no, one, two, three or more fingers on */
+#define FINGER_CLASSES 4
+
+typedef void (*GestureHandler)(GestureRecognizer*, FingerInfo*, int, int, TimeVal);
+
+struct GestureTransition {
+	/* What to do with the frame, may be NULL */
+	GestureHandler handler;
+	/* State afterwards */
+	int next;
+};
+
+/* Gesture recognition of one touch device. Turns frames into outputs without performing
+ * anything itself, so there can be any number of recognizers. */
+struct GestureRecognizer {
+	/* Configuration: where taps are performed (0 - first finger; 1 - second finger;
+	   2 - center), whether scrolling may ease out or be smooth, and where the profile of a
+	   gesture comes from */
+	int clickMode;
+	int easing;
+	int smoothScrolling;
+	Profile* (*getProfile)();
+	/* The transition table, with or without continuation */
+	const GestureTransition (*transitions)[FINGER_CLASSES];
+
+	/* TOUCH_* */
+	int touchState;
+	/* Has the recognizer pressed the first button? */
+	int buttonDown;
+
+	/* Outputs of the last frame */
+	GestureOutput outputs[MAX_GESTURE_OUTPUTS];
+	int outputCount;
+
+	/* Square of the maximum distance that two fingers have been moved while they were on */
+	double maxDistSquared;
+	/* The time when the first finger touched */
+	TimeVal fingerDownTime;
+
+	/* Profile of current window, if activated */
+	Profile* currentProfile;
+
+	/* Gesture information */
+	int amPerformingGesture;
+	/* Current profile has scrollBraceAction, thus mouse pointer has to be moved during scrolling */
+	int dragScrolling;
+
+	/* position of center between fingers at start of gesture */
+	int gestureStartCenterX, gestureStartCenterY;
+	/* distance between two fingers at start of gesture */
+	double gestureStartDist;
+	/* vector from first to second finger at start of gesture, turned with each rotation step */
+	double gestureStartVectorX, gestureStartVectorY;
+	/* current position of center between fingers */
+	int currentCenterX, currentCenterY;
+
+	/* Recent positions of the center, a ring of which nextScrollSample is the oldest
+	   once it is full, for the speed of the fingers when they are lifted. All of them
+	   were taken with the same number of fingers down. */
+	ScrollSample scrollSamples[SCROLL_SAMPLES];
+	int scrollSampleCount;
+	int nextScrollSample;
+	int scrollSampleFingers;
+	/* Smooth scrolling: finger motion (in pixels times SMOOTH_SCROLL_UNITS) that has
+	   not made up a whole unit yet */
+	int scrollRemainderX, scrollRemainderY;
+
+	/* Last known positions of the first two fingers of the current two-finger gesture,
+	   for the tap when they have already been released. */
+	FingerInfo gestureFingers[2];
+
+	/* Number of fingers of the swipe being performed (3 or 4) */
+	int swipeFingers;
+	/* position of center of all fingers at start of swipe */
+	int swipeStartCenterX, swipeStartCenterY;
+	/* Has the action of the current swipe been performed yet? */
+	int swipePerformed;
+};
+
+/* Maximum number of touch devices served at once */
+#define MAX_TOUCH_DEVICES 8
+
+/* Everything we know about one touch device */
+struct TouchDevice {
+	/* Device file, and its descriptor (-1 while the device is not available) */
+	char* devName;
+	int fileDesc;
+	/* Name of the device file within its directory, and the inotify watch of that directory */
+	char* fileName;
+	int watchDesc;
+	/* Name reported by the kernel */
+	char name[256];
+
+	/* Decoder for the kernel event stream, holds the finger information */
+	Decoder decoder;
+
+	/* XInput ids of the device, and of the one to read the calibration from */
+	int deviceID;
+	int calibrateDeviceID;
+
+	/* Calibration data */
+	int calibMinX, calibMaxX, calibMinY, calibMaxY;
+	unsigned char calibSwapX, calibSwapY, calibSwapAxes;
+	float calibMatrix[6];
+	int calibMatrixUse;
+
+	/* Finger data */
+	int fingersDown;
+	int fingersWereDown;
+	int currentTouchBlocked;
+	/* Do the events carry CLOCK_MONOTONIC timestamps? Otherwise frames are timed when they
+	   are processed. */
+	int kernelTimestamps;
+	/* Longest time from a frame's timestamp until it had been processed during the current touch */
+	long maxLatency;
+	/* Set by the input thread when a frame of the device had to be dropped because the
+	   ring was full; the next frame passed on is marked resynced */
+	int framesDropped;
+	/* The same for the events passed on while recording a trace */
+	int eventsDropped;
+
+	/* Jitter filter between calibration and the recognizer */
+	TouchFilter filter;
+
+	GestureRecognizer recognizer;
+};
+
+/* Most contacts passed on per frame, as many as the decoder can track */
+#define MAX_FRAME_CONTACTS DECODER_MAX_SLOTS
+
+#define INPUTFRAME_FRAME 0
+/* The data stream of the device stopped */
+#define INPUTFRAME_STOPPED 1
+/* Events read from the device, passed on ahead of their frames while recording a trace */
+#define INPUTFRAME_EVENTS 2
+
+/* Most events read from a device at once */
+#define MAX_READ_EVENTS 64
+
+typedef struct InputFrame InputFrame;
+
+/* A complete frame of a touch device, as passed from the input thread to the main thread */
+struct InputFrame {
+	int type;
+	TouchDevice* device;
+	/* Time the touch happened */
+	TimeVal time;
+	/* Have events been lost before this frame? */
+	int resynced;
+	int contactCount;
+	FingerInfo contacts[MAX_FRAME_CONTACTS];
+	/* INPUTFRAME_EVENTS only; resynced is set if earlier events could not be passed on */
+	int eventCount;
+	struct input_event events[MAX_READ_EVENTS];
+};
 
 int inDebugMode();
+int isRecordingTrace();
 int isEasingEnabled();
 
-void *xLoopThreadFunction(void *arg);
 int isWindowBlacklisted(Window w);
 
 Window getCurrentWindow();
 char* getWindowClass(Window);
+int getWindowClassId(Window);
 Window getLastChildWindow(Window);
 
 Window getActiveWindow();
+Profile* getActiveProfile();
 
-void processFingers();
+void processFingers(TouchDevice*, InputFrame*);
+void performGestureOutputs(GestureRecognizer*, TimeVal);
+void cancelGesture(TouchDevice*, TimeVal);
+int openTouchDevice(TouchDevice*);
+void openMissingDevices();
+
+void loadProfiles();
+void freeRetiredProfiles();
+void updatePassthrough();
 
 void pressButton();
 void releaseButton();
 int isButtonDown();
 
+int canScrollSmoothly();
+void scrollSmoothly(int dx, int dy);
 void movePointer(int, int, int);
+void compileAction(Action* action);
 void executeAction(Action* action, int what);
 
 void ungrab(Display *display,int deviceid);
 void grab(Display *display,int deviceid);
 
-int invalidWindowHandler(Display *dsp,XErrorEvent *err);
-
-void readCalibrationData(int exitOnFail, char* deviceName);
+void readCalibrationData(TouchDevice* device);
 void startContinuation();
 
-typedef struct timeval TimeVal;
-
 TimeVal getCurrentTime();
 
 int timeDiff(TimeVal start, TimeVal end);
+TimeVal timeAdd(TimeVal time, int milliSeconds);
 
 #endif /* TWOFINGEMU_H_ */
@@ -0,0 +1,251 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* uinput sink: creates a virtual mouse and keyboard and writes the output to it
+ * directly, bypassing the X connection. Events are collected until the sink is
+ * flushed and then written with a single write(), terminated by SYN_REPORT.
+ * Scrolling is reported in high resolution, plus the legacy wheel clicks.
+ * The argument is the uinput device node, /dev/uinput by default. */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include "twofingemu.h"
+#include "output.h"
+
+#define UINPUT_DEFAULT_PATH "/dev/uinput"
+#define UINPUT_DEVICE_NAME "twofing virtual pointer"
+/* Range of the absolute axes; scaled to the current screen size */
+#define UINPUT_ABS_MAX 65535
+#define UINPUT_MAX_PENDING 64
+
+/* X keycodes of evdev-based servers are the kernel key codes plus 8 */
+#define EVDEV_KEYCODE_OFFSET 8
+
+static int uinputDesc = -1;
+static Display* uinputDisplay;
+static struct input_event pending[UINPUT_MAX_PENDING];
+static int pendingCount;
+/* High-resolution scrolling not yet sent as a legacy wheel click */
+static int wheelRemainderX, wheelRemainderY;
+
+/* Kernel key codes for keysyms, used when there is no X connection to ask */
+static const struct {
+	KeySym keysym;
+	int code;
+} fallbackKeys[] = {
+	{ XK_Shift_L, KEY_LEFTSHIFT }, { XK_Control_L, KEY_LEFTCTRL },
+	{ XK_Alt_L, KEY_LEFTALT }, { XK_Super_L, KEY_LEFTMETA },
+	{ XK_Left, KEY_LEFT }, { XK_Right, KEY_RIGHT }, { XK_Up, KEY_UP }, { XK_Down, KEY_DOWN },
+	{ XK_Page_Up, KEY_PAGEUP }, { XK_Page_Down, KEY_PAGEDOWN },
+	{ XK_Home, KEY_HOME }, { XK_End, KEY_END },
+	{ XK_Tab, KEY_TAB }, { XK_Escape, KEY_ESC }, { XK_Return, KEY_ENTER },
+	{ XK_minus, KEY_MINUS }, { XK_equal, KEY_EQUAL },
+	{ XK_bracketleft, KEY_LEFTBRACE }, { XK_bracketright, KEY_RIGHTBRACE },
+	{ XK_R, KEY_R }, { XK_r, KEY_R },
+	{ NoSymbol, 0 }
+};
+
+static void uinputWrite() {
+	if (pendingCount == 0)
+		return;
+	if (write(uinputDesc, pending, pendingCount * sizeof(struct input_event)) < 0 && inDebugMode()) {
+		printf("Could not write to uinput device: %s\n", strerror(errno));
+	}
+	pendingCount = 0;
+}
+
+static void queueEvent(int type, int code, int value) {
+	int i;
+	/* Leave room for the final SYN_REPORT */
+	if (pendingCount >= UINPUT_MAX_PENDING - 2) {
+		pending[pendingCount].type = EV_SYN;
+		pending[pendingCount].code = SYN_REPORT;
+		pending[pendingCount].value = 0;
+		pendingCount++;
+		uinputWrite();
+	}
+	/* Two changes of the same key or axis in one report would be merged by the
+	 * receiver (a press and release would get lost), so report what we have first */
+	for (i = pendingCount - 1; i >= 0 && pending[i].type != EV_SYN; i--) {
+		if (pending[i].type == type && pending[i].code == code) {
+			queueEvent(EV_SYN, SYN_REPORT, 0);
+			break;
+		}
+	}
+
+	struct input_event* ev = &(pending[pendingCount++]);
+	memset(ev, 0, sizeof(struct input_event));
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static int uinputKeyCode(KeySym keysym) {
+	int i;
+	if (uinputDisplay != NULL) {
+		KeyCode keycode = XKeysymToKeycode(uinputDisplay, keysym);
+		return keycode >= EVDEV_KEYCODE_OFFSET ? keycode - EVDEV_KEYCODE_OFFSET : 0;
+	}
+	for (i = 0; fallbackKeys[i].keysym != NoSymbol; i++) {
+		if (fallbackKeys[i].keysym == keysym)
+			return fallbackKeys[i].code;
+	}
+	return 0;
+}
+
+static int uinputOpen(Display* display, const char* argument) {
+	struct uinput_setup setup;
+	struct uinput_abs_setup absSetup;
+	int code;
+
+	uinputDisplay = display;
+	pendingCount = 0;
+	wheelRemainderX = 0;
+	wheelRemainderY = 0;
+	uinputDesc = open(argument != NULL ? argument : UINPUT_DEFAULT_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+	if (uinputDesc < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", argument != NULL ? argument : UINPUT_DEFAULT_PATH, strerror(errno));
+		return -1;
+	}
+
+	ioctl(uinputDesc, UI_SET_EVBIT, EV_KEY);
+	for (code = KEY_ESC; code <= KEY_MICMUTE; code++) {
+		ioctl(uinputDesc, UI_SET_KEYBIT, code);
+	}
+	for (code = BTN_LEFT; code <= BTN_TASK; code++) {
+		ioctl(uinputDesc, UI_SET_KEYBIT, code);
+	}
+
+	ioctl(uinputDesc, UI_SET_EVBIT, EV_REL);
+	ioctl(uinputDesc, UI_SET_RELBIT, REL_WHEEL);
+	ioctl(uinputDesc, UI_SET_RELBIT, REL_HWHEEL);
+	ioctl(uinputDesc, UI_SET_RELBIT, REL_WHEEL_HI_RES);
+	ioctl(uinputDesc, UI_SET_RELBIT, REL_HWHEEL_HI_RES);
+
+	ioctl(uinputDesc, UI_SET_EVBIT, EV_ABS);
+	memset(&absSetup, 0, sizeof(absSetup));
+	absSetup.absinfo.maximum = UINPUT_ABS_MAX;
+	absSetup.code = ABS_X;
+	ioctl(uinputDesc, UI_ABS_SETUP, &absSetup);
+	absSetup.code = ABS_Y;
+	ioctl(uinputDesc, UI_ABS_SETUP, &absSetup);
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_VIRTUAL;
+	strcpy(setup.name, UINPUT_DEVICE_NAME);
+	if (ioctl(uinputDesc, UI_DEV_SETUP, &setup) < 0 || ioctl(uinputDesc, UI_DEV_CREATE) < 0) {
+		fprintf(stderr, "Could not create uinput device: %s\n", strerror(errno));
+		close(uinputDesc);
+		uinputDesc = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void uinputKey(int code, int press) {
+	queueEvent(EV_KEY, code, press ? 1 : 0);
+}
+
+/* Like a high-resolution mouse wheel: the fine-grained events plus a legacy click
+ * whenever a whole one has accumulated, for clients that only know the latter. */
+static void uinputScroll(int dx, int dy) {
+	if (dx != 0) {
+		queueEvent(EV_REL, REL_HWHEEL_HI_RES, dx);
+		wheelRemainderX += dx;
+		if (wheelRemainderX >= SMOOTH_SCROLL_UNITS || wheelRemainderX <= -SMOOTH_SCROLL_UNITS) {
+			queueEvent(EV_REL, REL_HWHEEL, wheelRemainderX / SMOOTH_SCROLL_UNITS);
+			wheelRemainderX %= SMOOTH_SCROLL_UNITS;
+		}
+	}
+	if (dy != 0) {
+		/* The wheel axis counts upwards */
+		queueEvent(EV_REL, REL_WHEEL_HI_RES, -dy);
+		wheelRemainderY += dy;
+		if (wheelRemainderY >= SMOOTH_SCROLL_UNITS || wheelRemainderY <= -SMOOTH_SCROLL_UNITS) {
+			queueEvent(EV_REL, REL_WHEEL, -wheelRemainderY / SMOOTH_SCROLL_UNITS);
+			wheelRemainderY %= SMOOTH_SCROLL_UNITS;
+		}
+	}
+}
+
+/* X buttons 4 to 7 are wheel clicks; they are sent once, on press */
+static void uinputButton(int button, int press) {
+	switch (button) {
+	case 1:
+		queueEvent(EV_KEY, BTN_LEFT, press ? 1 : 0);
+		break;
+	case 2:
+		queueEvent(EV_KEY, BTN_MIDDLE, press ? 1 : 0);
+		break;
+	case 3:
+		queueEvent(EV_KEY, BTN_RIGHT, press ? 1 : 0);
+		break;
+	case 4:
+	case 5:
+		if (press) {
+			queueEvent(EV_REL, REL_WHEEL_HI_RES, button == 4 ? SMOOTH_SCROLL_UNITS : -SMOOTH_SCROLL_UNITS);
+			queueEvent(EV_REL, REL_WHEEL, button == 4 ? 1 : -1);
+		}
+		break;
+	case 6:
+	case 7:
+		if (press) {
+			queueEvent(EV_REL, REL_HWHEEL_HI_RES, button == 6 ? -SMOOTH_SCROLL_UNITS : SMOOTH_SCROLL_UNITS);
+			queueEvent(EV_REL, REL_HWHEEL, button == 6 ? -1 : 1);
+		}
+		break;
+	case 8:
+		queueEvent(EV_KEY, BTN_SIDE, press ? 1 : 0);
+		break;
+	case 9:
+		queueEvent(EV_KEY, BTN_EXTRA, press ? 1 : 0);
+		break;
+	}
+}
+
+static void uinputMotion(int x, int y, int width, int height) {
+	if (width < 2 || height < 2)
+		return;
+	queueEvent(EV_ABS, ABS_X, (long) x * UINPUT_ABS_MAX / (width - 1));
+	queueEvent(EV_ABS, ABS_Y, (long) y * UINPUT_ABS_MAX / (height - 1));
+}
+
+static void uinputFlush() {
+	if (pendingCount == 0)
+		return;
+	queueEvent(EV_SYN, SYN_REPORT, 0);
+	uinputWrite();
+}
+
+static void uinputClose() {
+	if (uinputDesc < 0)
+		return;
+	uinputFlush();
+	ioctl(uinputDesc, UI_DEV_DESTROY);
+	close(uinputDesc);
+	uinputDesc = -1;
+	uinputDisplay = NULL;
+}
+
+OutputSink uinputSink = { "uinput", uinputOpen, uinputKeyCode, uinputKey, uinputButton, uinputMotion, uinputScroll, uinputFlush, uinputClose, 0 };
@@ -0,0 +1,322 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include "twofingemu.h"
+#include "classes.h"
+#include "windows.h"
+
+#define INITIAL_BUCKET_COUNT 1024
+
+/* What we need to hear about from every mirrored window: changes of its children and of WM_CLASS */
+#define WINDOW_TREE_EVENT_MASK (SubstructureNotifyMask | PropertyChangeMask)
+
+static Display* treeDisplay;
+static WindowNode* rootNode;
+static WindowNode** buckets;
+static int bucketCount;
+static int nodeCount;
+static int (*previousErrorHandler)(Display*, XErrorEvent*);
+/* Windows created during the current event batch whose class and children still have to
+ * be read; kept by id, as they may be destroyed again before we get to them */
+static Window* pendingWindows;
+static int pendingCount;
+static int pendingCapacity;
+
+static unsigned int hashWindow(Window window) {
+	return (unsigned int) (window ^ (window >> 16)) & (bucketCount - 1);
+}
+
+/* Returns the mirrored node of the given window, or NULL if the window is not known */
+WindowNode* findWindowNode(Window window) {
+	WindowNode* node;
+	if (buckets == NULL)
+		return NULL;
+	for (node = buckets[hashWindow(window)]; node != NULL; node = node->hashNext) {
+		if (node->window == window)
+			return node;
+	}
+	return NULL;
+}
+
+static void growBuckets() {
+	int oldCount = bucketCount;
+	WindowNode** oldBuckets = buckets;
+	WindowNode** newBuckets = calloc(oldCount * 2, sizeof(WindowNode*));
+	int i;
+	if (newBuckets == NULL)
+		return;
+
+	buckets = newBuckets;
+	bucketCount = oldCount * 2;
+	for (i = 0; i < oldCount; i++) {
+		WindowNode* node = oldBuckets[i];
+		while (node != NULL) {
+			WindowNode* next = node->hashNext;
+			unsigned int bucket = hashWindow(node->window);
+			node->hashNext = buckets[bucket];
+			buckets[bucket] = node;
+			node = next;
+		}
+	}
+	free(oldBuckets);
+}
+
+/* Removes the node from the children of its parent */
+static void unlinkNode(WindowNode* node) {
+	WindowNode* parent = node->parent;
+	if (parent == NULL)
+		return;
+	if (node->prevSibling != NULL) node->prevSibling->nextSibling = node->nextSibling;
+	else parent->firstChild = node->nextSibling;
+	if (node->nextSibling != NULL) node->nextSibling->prevSibling = node->prevSibling;
+	else parent->lastChild = node->prevSibling;
+	node->parent = NULL;
+	node->prevSibling = NULL;
+	node->nextSibling = NULL;
+}
+
+/* Adds the node to the children of parent, right above sibling, or at the bottom if sibling is NULL */
+static void linkNodeAbove(WindowNode* node, WindowNode* parent, WindowNode* sibling) {
+	node->parent = parent;
+	node->prevSibling = sibling;
+	node->nextSibling = sibling != NULL ? sibling->nextSibling : parent->firstChild;
+	if (node->prevSibling != NULL) node->prevSibling->nextSibling = node;
+	else parent->firstChild = node;
+	if (node->nextSibling != NULL) node->nextSibling->prevSibling = node;
+	else parent->lastChild = node;
+}
+
+/* Reads WM_CLASS of the node's window from the server */
+static void readClass(WindowNode* node) {
+	XClassHint classHint;
+	node->classId = CLASS_NONE;
+	node->hasClassHint = 0;
+	if (XGetClassHint(treeDisplay, node->window, &classHint)) {
+		node->hasClassHint = 1;
+		if (classHint.res_class != NULL) {
+			if (classHint.res_name != NULL)
+				node->classId = internClass(classHint.res_name);
+			XFree(classHint.res_class);
+		}
+		if (classHint.res_name != NULL) XFree(classHint.res_name);
+	}
+}
+
+/* Creates the node of a new window on top of its siblings and starts listening to it.
+ * Its class is not read yet. */
+static WindowNode* addNode(Window window, WindowNode* parent) {
+	WindowNode* node = calloc(1, sizeof(WindowNode));
+	if (node == NULL)
+		return NULL;
+	node->window = window;
+	node->classId = CLASS_NONE;
+
+	if (nodeCount >= bucketCount)
+		growBuckets();
+	unsigned int bucket = hashWindow(window);
+	node->hashNext = buckets[bucket];
+	buckets[bucket] = node;
+	nodeCount++;
+
+	if (parent != NULL)
+		linkNodeAbove(node, parent, parent->lastChild);
+
+	XSelectInput(treeDisplay, window, WINDOW_TREE_EVENT_MASK);
+	return node;
+}
+
+/* Removes the node and all of its descendants */
+static void removeNode(WindowNode* node) {
+	while (node->firstChild != NULL)
+		removeNode(node->firstChild);
+	unlinkNode(node);
+
+	WindowNode** link = &(buckets[hashWindow(node->window)]);
+	while (*link != node)
+		link = &((*link)->hashNext);
+	*link = node->hashNext;
+	nodeCount--;
+
+	free(node);
+}
+
+/* Adds the children of the given node as the server reports them, recursively. Children
+ * already known from their CreateNotify are left as they are. */
+static void seedChildren(WindowNode* node) {
+	Window root, parent;
+	Window* children = NULL;
+	unsigned int childCount, i;
+	if (!XQueryTree(treeDisplay, node->window, &root, &parent, &children, &childCount))
+		return;
+	for (i = 0; i < childCount; i++) {
+		if (findWindowNode(children[i]) != NULL)
+			continue;
+		WindowNode* child = addNode(children[i], node);
+		if (child != NULL) {
+			readClass(child);
+			seedChildren(child);
+		}
+	}
+	if (children != NULL)
+		XFree(children);
+}
+
+/* Remembers a new window to be read by processPendingWindows() */
+static void addPendingWindow(Window window) {
+	if (pendingCount == pendingCapacity) {
+		int capacity = pendingCapacity == 0 ? 16 : pendingCapacity * 2;
+		Window* windows = realloc(pendingWindows, capacity * sizeof(Window));
+		if (windows == NULL)
+			return;
+		pendingWindows = windows;
+		pendingCapacity = capacity;
+	}
+	pendingWindows[pendingCount++] = window;
+}
+
+/* Windows may be destroyed before we get to ask for them; ignore the errors caused by that */
+static int windowTreeErrorHandler(Display* display, XErrorEvent* err) {
+	if (err->error_code == BadWindow)
+		return 0;
+	return previousErrorHandler(display, err);
+}
+
+/* Builds the mirror of the window tree below root. The events of root selected by the
+ * caller have to include WINDOW_TREE_EVENT_MASK. Returns 0 on success. */
+int initWindowTree(Display* display, Window root) {
+	treeDisplay = display;
+	bucketCount = INITIAL_BUCKET_COUNT;
+	nodeCount = 0;
+	buckets = calloc(bucketCount, sizeof(WindowNode*));
+	rootNode = calloc(1, sizeof(WindowNode));
+	if (buckets == NULL || rootNode == NULL) {
+		free(buckets);
+		free(rootNode);
+		buckets = NULL;
+		return -1;
+	}
+	rootNode->window = root;
+	rootNode->classId = CLASS_NONE;
+	buckets[hashWindow(root)] = rootNode;
+	nodeCount = 1;
+
+	previousErrorHandler = XSetErrorHandler(windowTreeErrorHandler);
+
+	/* Nothing may change while we look */
+	XGrabServer(display);
+	seedChildren(rootNode);
+	XUngrabServer(display);
+	XFlush(display);
+
+	if (inDebugMode()) printf("Mirrored %i windows\n", nodeCount);
+	return 0;
+}
+
+/* Updates the mirror from the given event if it is about the window tree */
+void updateWindowTree(XEvent* ev) {
+	WindowNode* node;
+	WindowNode* parent;
+
+	if (buckets == NULL)
+		return;
+
+	switch (ev->type) {
+	case CreateNotify:
+		/* Menus, tooltips and the like never take the focus, so they don't need to be mirrored */
+		if (ev->xcreatewindow.override_redirect)
+			break;
+		parent = findWindowNode(ev->xcreatewindow.parent);
+		if (parent != NULL && findWindowNode(ev->xcreatewindow.window) == NULL) {
+			node = addNode(ev->xcreatewindow.window, parent);
+			/* Its class and the children it might have got before we listened to it
+			   are read once the event batch is done */
+			if (node != NULL)
+				addPendingWindow(node->window);
+		}
+		break;
+	case DestroyNotify:
+		node = findWindowNode(ev->xdestroywindow.window);
+		if (node != NULL && node != rootNode)
+			removeNode(node);
+		break;
+	case ReparentNotify:
+		/* Reported to the old and the new parent */
+		node = findWindowNode(ev->xreparent.window);
+		parent = findWindowNode(ev->xreparent.parent);
+		if (node == NULL || node == rootNode || node->parent == parent)
+			break;
+		if (parent == NULL) {
+			/* Moved somewhere we don't know; forget about it */
+			removeNode(node);
+			break;
+		}
+		unlinkNode(node);
+		linkNodeAbove(node, parent, parent->lastChild);
+		break;
+	case ConfigureNotify:
+		/* Restacking */
+		node = findWindowNode(ev->xconfigure.window);
+		if (node == NULL || node->parent == NULL)
+			break;
+		parent = node->parent;
+		WindowNode* sibling = NULL;
+		if (ev->xconfigure.above != None) {
+			sibling = findWindowNode(ev->xconfigure.above);
+			if (sibling == NULL || sibling == node || sibling->parent != parent)
+				break;
+		}
+		if (sibling == node->prevSibling)
+			break;
+		unlinkNode(node);
+		linkNodeAbove(node, parent, sibling);
+		break;
+	case CirculateNotify:
+		node = findWindowNode(ev->xcirculate.window);
+		if (node == NULL || node->parent == NULL)
+			break;
+		parent = node->parent;
+		unlinkNode(node);
+		linkNodeAbove(node, parent, ev->xcirculate.place == PlaceOnTop ? parent->lastChild : NULL);
+		break;
+	case PropertyNotify:
+		if (ev->xproperty.atom == XA_WM_CLASS) {
+			node = findWindowNode(ev->xproperty.window);
+			if (node != NULL)
+				readClass(node);
+		}
+		break;
+	}
+}
+
+/* Reads the class and children of the windows created since the last call. Called after
+ * each batch of X events, so that creating windows doesn't cost a round trip per event. */
+void processPendingWindows() {
+	int i;
+	for (i = 0; i < pendingCount; i++) {
+		WindowNode* node = findWindowNode(pendingWindows[i]);
+		if (node != NULL) {
+			readClass(node);
+			seedChildren(node);
+		}
+	}
+	pendingCount = 0;
+}
@@ -0,0 +1,50 @@
+/*
+ Copyright (C) 2026 Philipp Merkel <linux@philmerk.de>
+
+ Permission to use, copy, modify, and/or distribute this software for any
+ purpose with or without fee is hereby granted, provided that the above
+ copyright notice and this permission notice appear in all copies.
+
+ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef WINDOWS_H_
+#define WINDOWS_H_
+
+#include <X11/Xlib.h>
+
+/* Client-side mirror of the window hierarchy and the WM_CLASS of each window.
+ * It is seeded once with XQueryTree and then kept up to date from the
+ * SubstructureNotify and PropertyNotify events of every window, so that walking
+ * the tree doesn't need any round trips to the X server. */
+
+typedef struct WindowNode WindowNode;
+
+struct WindowNode {
+	Window window;
+	WindowNode* parent;
+	/* Children in stacking order, bottom to top */
+	WindowNode* firstChild;
+	WindowNode* lastChild;
+	WindowNode* prevSibling;
+	WindowNode* nextSibling;
+	/* Does the window have WM_CLASS set? */
+	int hasClassHint;
+	/* Interned instance name from WM_CLASS (as returned by getWindowClass()), or CLASS_NONE */
+	int classId;
+	/* Next node in the same hash bucket */
+	WindowNode* hashNext;
+};
+
+int initWindowTree(Display* display, Window root);
+void updateWindowTree(XEvent* ev);
+void processPendingWindows();
+WindowNode* findWindowNode(Window window);
+
+#endif /* WINDOWS_H_ */